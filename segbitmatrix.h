@@ -0,0 +1,203 @@
+// Copyright (c) 2024 Chao Wang <hit9@icloud.com>.
+// License: BSD. https://github.com/hit9/segbitset
+// A bit matrix of R rows of segbitset<C>, e.g. the adjacency matrix of a graph.
+//
+// Above the rows, a segbitset<R> summarizes which rows are non-empty, so the operations over rows walk only
+// the non-empty ones, like the OR summary of a segbitset skips empty subtrees:
+//
+//   column(c): tests c on each non-empty row.
+//   reduce_or(selected): ors the rows both selected and non-empty.
+//   rows_intersecting(mask): the non-empty rows having a true bit in common with mask, each checked by a
+//     walk that stops at the first common bit.
+//   transpose(out): gathers each band of 64 rows into 64x64 blocks of words, transposes the non-empty
+//     blocks by transpose64 in 6 rounds of swaps, and writes them out row by row.
+//
+// Rows are read by row(r), and written by set/reset of a bit or set_row, which keep the summary coherent.
+//
+// Usage:
+//   auto adjacency = std::make_unique<segbitset::segbitmatrix<1024, 1024>>();
+//   adjacency->set(u, v);
+//   auto neighbors = adjacency->reduce_or(frontier);  // vertices adjacent to any in frontier
+//   auto sources = adjacency->column(v);              // rows having an edge to v
+
+#ifndef __HIT9_SEGBITMATRIX
+#define __HIT9_SEGBITMATRIX
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "segbitset.h"
+
+namespace segbitset {
+
+// transposes a 64x64 block of bits in place, bit c of a[r] being the element (r, c), by swapping the
+// off-diagonal halves of blocks of 32, 16, ..., 1 rows.
+inline void transpose64(uint64_t a[64]) noexcept {
+  uint64_t m = 0x00000000FFFFFFFF;  // lower half of the columns of each block
+  for (unsigned j = 32; j; j >>= 1, m ^= m << j) {
+    for (unsigned k = 0; k < 64; k = ((k | j) + 1) & ~j) {
+      // swaps the upper half of the columns of row k with the lower half of row k+j.
+      auto t = ((a[k] >> j) ^ a[k | j]) & m;
+      a[k | j] ^= t;
+      a[k] ^= t << j;
+    }
+  }
+}
+
+template <size_t R, size_t C, template <size_t> class Storage = word_bitset>
+class segbitmatrix {
+ public:
+  using row_type = segbitset<C, Storage>;
+  using column_type = segbitset<R, Storage>;
+
+  segbitmatrix() = default;
+
+  // returns the number of rows, that is R.
+  constexpr size_t rows() const noexcept { return R; }
+  // returns the number of columns, that is C.
+  constexpr size_t columns() const noexcept { return C; }
+
+  // returns the bit at (r, c).
+  // throws std::out_of_range if r or c is invalid.
+  bool test(size_t r, size_t c) const { return row(r).test(c); }
+  // sets the bit at (r, c) to the given value.
+  // throws std::out_of_range if r or c is invalid.
+  segbitmatrix& set(size_t r, size_t c, bool value = true);
+  // sets the bit at (r, c) to false.
+  // throws std::out_of_range if r or c is invalid.
+  segbitmatrix& reset(size_t r, size_t c) { return set(r, c, false); }
+  // replaces row r.
+  // throws std::out_of_range if r is invalid.
+  segbitmatrix& set_row(size_t r, const row_type& row);
+  // sets all bits to false, walking only the non-empty rows.
+  segbitmatrix& reset() noexcept;
+
+  // returns row r.
+  // throws std::out_of_range if r is invalid.
+  const row_type& row(size_t r) const {
+    if (r >= R) throw std::out_of_range("segbitmatrix::row r >= R");
+    return __rows[r];
+  }
+  // returns the summary of rows, whose bit r tells whether row r has any true bit.
+  const column_type& nonempty_rows() const noexcept { return __nonempty; }
+  // returns the number of true bits.
+  size_t count() const noexcept;
+
+  // returns column c, as the set of rows having a true bit at c.
+  // throws std::out_of_range if c is invalid.
+  column_type column(size_t c) const;
+  // returns the OR of all rows.
+  row_type reduce_or() const noexcept { return reduce_or(__nonempty); }
+  // returns the OR of the rows selected, e.g. the neighbors of a set of vertices of a graph.
+  row_type reduce_or(const column_type& selected) const noexcept;
+  // returns the set of rows having a true bit in common with mask.
+  column_type rows_intersecting(const row_type& mask) const noexcept;
+  // fills out with the transpose of this matrix, resetting it first.
+  void transpose(segbitmatrix<C, R, Storage>& out) const;
+
+ private:
+  row_type __rows[R];
+  column_type __nonempty;  // bit r is true if row r is non-empty
+
+  // updates the summary of row r.
+  void __update(size_t r) noexcept {
+    if (bool any = __rows[r].any(); any != __nonempty.test(r)) __nonempty.set(r, any);
+  }
+};
+
+template <size_t R, size_t C, template <size_t> class Storage>
+segbitmatrix<R, C, Storage>& segbitmatrix<R, C, Storage>::set(size_t r, size_t c, bool value) {
+  if (r >= R) throw std::out_of_range("segbitmatrix::set r >= R");
+  __rows[r].set(c, value);
+  __update(r);
+  return *this;
+}
+
+template <size_t R, size_t C, template <size_t> class Storage>
+segbitmatrix<R, C, Storage>& segbitmatrix<R, C, Storage>::set_row(size_t r, const row_type& row) {
+  if (r >= R) throw std::out_of_range("segbitmatrix::set_row r >= R");
+  __rows[r] = row;
+  __update(r);
+  return *this;
+}
+
+template <size_t R, size_t C, template <size_t> class Storage>
+segbitmatrix<R, C, Storage>& segbitmatrix<R, C, Storage>::reset() noexcept {
+  __nonempty.foreach1([&](size_t r) { __rows[r].reset(); });
+  __nonempty.reset();
+  return *this;
+}
+
+template <size_t R, size_t C, template <size_t> class Storage>
+size_t segbitmatrix<R, C, Storage>::count() const noexcept {
+  size_t n = 0;
+  __nonempty.foreach1([&](size_t r) { n += __rows[r].count(); });
+  return n;
+}
+
+template <size_t R, size_t C, template <size_t> class Storage>
+typename segbitmatrix<R, C, Storage>::column_type segbitmatrix<R, C, Storage>::column(size_t c) const {
+  if (c >= C) throw std::out_of_range("segbitmatrix::column c >= C");
+  column_type ans;
+  __nonempty.foreach1([&](size_t r) {
+    if (__rows[r].test(c)) ans.set(r);
+  });
+  return ans;
+}
+
+template <size_t R, size_t C, template <size_t> class Storage>
+typename segbitmatrix<R, C, Storage>::row_type segbitmatrix<R, C, Storage>::reduce_or(
+    const column_type& selected) const noexcept {
+  row_type ans;
+  auto rows = selected;
+  rows &= __nonempty;  // walks only the selected rows
+  rows.foreach1([&](size_t r) { ans |= __rows[r]; });
+  return ans;
+}
+
+template <size_t R, size_t C, template <size_t> class Storage>
+typename segbitmatrix<R, C, Storage>::column_type segbitmatrix<R, C, Storage>::rows_intersecting(
+    const row_type& mask) const noexcept {
+  column_type ans;
+  if (mask.none()) return ans;
+  __nonempty.foreach1([&](size_t r) {
+    if (__rows[r].intersects(mask)) ans.set(r);
+  });
+  return ans;
+}
+
+template <size_t R, size_t C, template <size_t> class Storage>
+void segbitmatrix<R, C, Storage>::transpose(segbitmatrix<C, R, Storage>& out) const {
+  static constexpr size_t BLOCKS = (C + 63) / 64;  // blocks of a band of rows
+  out.reset();
+  std::vector<std::array<uint64_t, 64>> blocks(BLOCKS);  // blocks[b][i] is row i of the band, columns of b
+  segbitset<BLOCKS, Storage> touched;                    // non-empty blocks of the band
+  for (auto r = __nonempty.first(); r < R;) {
+    // gathers the non-empty rows of the band of r, leaving r at the first non-empty row of the next bands.
+    auto band = r >> 6;
+    for (; r < R && (r >> 6) == band; r = __nonempty.next(r)) {
+      __rows[r].foreach1([&](size_t c) {
+        blocks[c >> 6][r & 63] |= uint64_t(1) << (c & 63);
+        if (!touched.test(c >> 6)) touched.set(c >> 6);
+      });
+    }
+    // transposes the non-empty blocks of the band, and writes them out.
+    touched.foreach1([&](size_t b) {
+      auto& block = blocks[b];
+      transpose64(block.data());
+      for (size_t i = 0; i < 64; i++) {  // row i of the transposed block is column 64b+i of the band
+        for (auto m = block[i]; m; m &= m - 1) out.set((b << 6) + i, (band << 6) + std::countr_zero(m));
+        block[i] = 0;
+      }
+    });
+    touched.reset();
+  }
+}
+
+}  // namespace segbitset
+
+#endif
@@ -0,0 +1,82 @@
+#include "segbitmatrix.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+static std::mt19937 rng(std::random_device{}());
+
+TEST_CASE("segbitmatrix", "[transpose64]") {
+  std::uniform_int_distribution<uint64_t> distribution;
+  uint64_t a[64], b[64];
+  for (auto& w : a) w = distribution(rng);
+  for (int i = 0; i < 64; i++) b[i] = a[i];
+  segbitset::transpose64(b);
+  for (int r = 0; r < 64; r++)
+    for (int c = 0; c < 64; c++) REQUIRE(((a[r] >> c) & 1) == ((b[c] >> r) & 1));
+  segbitset::transpose64(b);
+  for (int i = 0; i < 64; i++) REQUIRE(a[i] == b[i]);
+}
+
+TEST_CASE("segbitmatrix", "[row and column operations - compare to brute force]") {
+  const std::size_t R = 150, C = 200;
+  auto m = std::make_unique<segbitset::segbitmatrix<R, C>>();
+  std::vector<std::vector<bool>> e(R, std::vector<bool>(C));
+  std::uniform_int_distribution<std::size_t> rows(0, R - 1), columns(0, C - 1);
+  for (int i = 0; i < 2000; i++) {
+    // leaves about half of the rows empty.
+    auto r = rows(rng) | 1, c = columns(rng);
+    bool value = i % 5;
+    m->set(r, c, value);
+    e[r][c] = value;
+  }
+  std::size_t n = 0;
+  for (std::size_t r = 0; r < R; r++) {
+    bool any = false;
+    for (std::size_t c = 0; c < C; c++) {
+      REQUIRE(m->test(r, c) == e[r][c]);
+      any = any || e[r][c];
+      n += e[r][c];
+    }
+    REQUIRE(m->nonempty_rows().test(r) == any);
+  }
+  REQUIRE(m->count() == n);
+  for (int i = 0; i < 20; i++) {
+    auto c = columns(rng);
+    auto column = m->column(c);
+    for (std::size_t r = 0; r < R; r++) REQUIRE(column.test(r) == e[r][c]);
+  }
+  segbitset::segbitset<R> selected;
+  for (int i = 0; i < 10; i++) selected.set(rows(rng));
+  auto neighbors = m->reduce_or(selected);
+  segbitset::segbitset<C> mask;
+  for (int i = 0; i < 3; i++) mask.set(columns(rng));
+  auto intersecting = m->rows_intersecting(mask);
+  for (std::size_t c = 0; c < C; c++) {
+    bool any = false;
+    for (std::size_t r = 0; r < R; r++) any = any || (selected.test(r) && e[r][c]);
+    REQUIRE(neighbors.test(c) == any);
+  }
+  for (std::size_t r = 0; r < R; r++) {
+    bool any = false;
+    for (std::size_t c = 0; c < C; c++) any = any || (mask.test(c) && e[r][c]);
+    REQUIRE(intersecting.test(r) == any);
+  }
+  auto t = std::make_unique<segbitset::segbitmatrix<C, R>>();
+  t->set(0, 0);  // reset by transpose
+  m->transpose(*t);
+  REQUIRE(t->count() == n);
+  for (std::size_t r = 0; r < R; r++)
+    for (std::size_t c = 0; c < C; c++) REQUIRE(t->test(c, r) == e[r][c]);
+  m->set_row(1, segbitset::segbitset<C>());
+  REQUIRE(!m->nonempty_rows().test(1));
+  m->reset();
+  REQUIRE(m->nonempty_rows().none());
+  REQUIRE(m->count() == 0);
+  REQUIRE(m->rows_intersecting(mask).none());
+  REQUIRE_THROWS_AS(m->set(R, 0), std::out_of_range);
+  REQUIRE_THROWS_AS(m->column(C), std::out_of_range);
+}
@@ -19,26 +19,373 @@
 //  1. set(pos),test(pos),flip(pos) now are slower than std::bitset, O(logN).
 //  2. occupying x4 times space than an equivalent std::bitset.
 //  3. shift operations and to_string/to_ulong aren't implementated yet.
+//
+// Storage:
+//  The tree bits live in a storage class template Storage<M>, which defaults to word_bitset,
+//  a constexpr-capable bitset, so a segbitset can be built and queried in constant expressions.
+//  std::bitset is also accepted as a storage, e.g. segbitset<N, std::bitset>.
+//
+// Stats:
+//  The third template parameter is a stats policy counting nodes visited, subtrees pruned, leaves visited
+//  and pushups per operation type, read by stats(). It defaults to no_stats, which costs nothing,
+//  e.g. segbitset<N, word_bitset, counting_stats> to count.
+//
+// Summary:
+//  The fourth template parameter is the summary policy, a monoid telling what each node summarizes of the
+//  bits below it. It defaults to or_summary, which is the tree bits themselves, and costs nothing. Other
+//  policies (and_summary, count_summary, zero_run_summary, or user defined ones) are kept per node next to
+//  the OR bits, which walks still prune on, updated by each pushup, and read by summary(first, last).
+//  Adaptive flat kernels are off on them, since they'd leave the stored summaries stale.
+//
+// Build options (macros):
+//  SEGBITSET_RECURSIVE_WALK: walks the tree recursively instead of on an explicit stack.
+//  SEGBITSET_PREFETCH_DISTANCE: prefetches the descendants of a node that many levels below while
+//    descending the tree, 0 (default) to disable. Helps when the tree doesn't fit in cache.
+//  SEGBITSET_NO_USDT: leaves out the USDT probes (see below).
+//
+// USDT probes:
+//  On Linux with <sys/sdt.h> (systemtap-sdt-dev), bulk operations and iterations fire static tracepoints,
+//  which are single nops until a tracer attaches, so they can be profiled in production without rebuilds:
+//    segbitset:op_entry(op, N, operand_size)
+//    segbitset:op_return(op, N, result, visited)
+//  op is a stats_op, operand_size is the size in bits of the other operand (0 if none), result is the
+//  count, the position found or the equality, and visited is the number of nodes the walk visited, which
+//  is only counted with a counting Stats policy (0 otherwise). e.g. with bpftrace:
+//    bpftrace -e 'usdt:./a.out:segbitset:op_return { @calls[arg0] = count(); @visited[arg0] = sum(arg3); }'
 
 #ifndef __HIT9_SEGBITSET
 #define __HIT9_SEGBITSET
 
+#include <array>
+#include <bit>  // for bit_width
 #include <bitset>
-#include <cstddef>     // for size_t
-#include <functional>  // for function
+#include <cstddef>           // for size_t
+#include <cstdint>           // for uint64_t
+#include <functional>        // for function
+#include <initializer_list>  // for initializer_list
 #include <stdexcept>
+#include <type_traits>  // for is_constant_evaluated
+#include <utility>      // for as_const, pair
+
+#ifndef SEGBITSET_PREFETCH_DISTANCE
+#define SEGBITSET_PREFETCH_DISTANCE 0
+#endif
+
+#if !defined(SEGBITSET_NO_USDT) && defined(__linux__) && __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define SEGBITSET_USDT
+#endif
 
 namespace segbitset {
 
 using size_t = std::size_t;
 
 // callback is a function that receives a position as parameter.
+// foreach1 accepts any callable of this signature, callback is kept for convenience.
 using callback = std::function<void(size_t pos)>;
 
-template <size_t N>
+// bit_reference is a reference to a bit of a storage, via its set(pos, value) and const operator[].
+template <typename Bitset>
+class bit_reference {
+ private:
+  Bitset& b;
+  const size_t pos = 0;
+
+ public:
+  constexpr explicit bit_reference(Bitset& b, size_t pos) : b(b), pos(pos) {}
+
+  constexpr bit_reference& operator=(bool value) noexcept {
+    b.set(pos, value);
+    return *this;
+  }
+  constexpr bit_reference& operator=(const bit_reference& o) noexcept { return *this = bool(o); }
+  constexpr operator bool() const noexcept { return std::as_const(b)[pos]; }
+};
+
+// word_bitset is a fixed-size bitset of M bits stored in 64-bit words.
+// Unlike std::bitset (before C++23), all its mutators are constexpr,
+// it's the default storage of segbitset.
+template <size_t M>
+class word_bitset {
+  using __word_bitset = word_bitset<M>;
+  static constexpr size_t W = (M + 63) >> 6;  // number of words
+
+ public:
+  using reference = bit_reference<__word_bitset>;
+
+  // returns the number of bits that this bitset holds
+  constexpr size_t size() const noexcept { return M; }
+  // returns the value of the bit at position pos, without bounds checking.
+  constexpr bool operator[](size_t pos) const noexcept { return (words[pos >> 6] >> (pos & 63)) & 1; }
+  // returns a reference to the bit at position pos, without bounds checking.
+  constexpr reference operator[](size_t pos) noexcept { return reference(*this, pos); }
+  // sets the bit at position pos to the given value, without bounds checking.
+  constexpr __word_bitset& set(size_t pos, bool value = true) noexcept {
+    auto mask = uint64_t(1) << (pos & 63);
+    auto& w = words[pos >> 6];
+    w = (w & ~mask) | (-uint64_t(value) & mask);  // branchless
+    return *this;
+  }
+  // sets all bits to true.
+  constexpr __word_bitset& set() noexcept {
+    for (auto& w : words) w = ~uint64_t(0);
+    if constexpr ((M & 63) != 0) words[W - 1] = (uint64_t(1) << (M & 63)) - 1;
+    return *this;
+  }
+  // sets all bits to false.
+  constexpr __word_bitset& reset() noexcept {
+    for (auto& w : words) w = 0;
+    return *this;
+  }
+  // hints that the bit at position pos is going to be read soon, no-op on constant evaluation.
+  constexpr void prefetch(size_t pos) const noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+    if (!std::is_constant_evaluated()) __builtin_prefetch(&words[pos >> 6]);
+#endif
+  }
+  // ors the bits of o into this bitset, word by word.
+  constexpr __word_bitset& operator|=(const __word_bitset& o) noexcept {
+    for (size_t i = 0; i < W; i++) words[i] |= o.words[i];
+    return *this;
+  }
+  constexpr bool operator==(const __word_bitset& o) const noexcept = default;
+
+ private:
+  uint64_t words[W]{};
+};
+
+// veb_bitset is a storage for segbitset, keeping the tree nodes in van Emde Boas order instead of
+// the heap order (x, 2x, 2x+1): the tree is cut at half of its height, the top tree is stored first,
+// then each bottom tree one after another, all recursively in the same way. So that a root-to-leaf path
+// touches O(log_B N) cache lines for any cache line size B, rather than O(log N) distant lines.
+// Positions are still addressed in heap order, each access pays O(log log N) arithmetic to locate.
+//
+// Usage: segbitset<N, veb_bitset>. It only stores the positions of tree nodes, that is [1, 2^H) of the
+// 1 + 4N positions of a segbitset<N>, H being the tree depth, which makes it often smaller than a
+// word_bitset, but also makes it not general purpose.
+template <size_t M>
+class veb_bitset {
+  using __veb_bitset = veb_bitset<M>;
+  static_assert(M > 4 && (M - 1) % 4 == 0, "veb_bitset only stores segbitset trees");
+  static constexpr size_t H = std::bit_width((M - 1) / 4 - 1) + 1;  // tree depth of segbitset<(M-1)/4>
+
+  // returns the position in van Emde Boas order of heap position x (x > 0), in a tree of depth H.
+  static constexpr size_t __veb(size_t x) noexcept {
+    size_t base = 0, h = H;
+    while (h > 1) {
+      size_t d = std::bit_width(x) - 1;  // depth of x
+      size_t ht = h >> 1, hb = h - ht;   // heights of top and bottom trees
+      if (d < ht) {                      // inside the top tree
+        h = ht;
+        continue;
+      }
+      size_t k = d - ht;                         // depth inside the bottom tree
+      size_t j = (x >> k) - (size_t(1) << ht);  // which bottom tree
+      base += ((size_t(1) << ht) - 1) + j * ((size_t(1) << hb) - 1);
+      x = (x & ((size_t(1) << k) - 1)) | (size_t(1) << k);  // position inside the bottom tree
+      h = hb;
+    }
+    return base;
+  }
+
+ public:
+  using reference = bit_reference<__veb_bitset>;
+
+  // returns the number of bits this storage stands for (which is M, not the actually occupied).
+  constexpr size_t size() const noexcept { return M; }
+  // returns the value of the bit at heap position pos (0 < pos < 2^H), without bounds checking.
+  constexpr bool operator[](size_t pos) const noexcept { return bits[__veb(pos)]; }
+  // returns a reference to the bit at heap position pos (0 < pos < 2^H), without bounds checking.
+  constexpr reference operator[](size_t pos) noexcept { return reference(*this, pos); }
+  // sets the bit at heap position pos (0 < pos < 2^H) to the given value, without bounds checking.
+  constexpr __veb_bitset& set(size_t pos, bool value = true) noexcept {
+    bits.set(__veb(pos), value);
+    return *this;
+  }
+  // sets all bits to true.
+  constexpr __veb_bitset& set() noexcept {
+    bits.set();
+    return *this;
+  }
+  // sets all bits to false.
+  constexpr __veb_bitset& reset() noexcept {
+    bits.reset();
+    return *this;
+  }
+  // hints that the bit at heap position pos is going to be read soon.
+  constexpr void prefetch(size_t pos) const noexcept {
+    if (pos < (size_t(1) << H)) bits.prefetch(__veb(pos));
+  }
+  // ors the bits of o into this storage.
+  constexpr __veb_bitset& operator|=(const __veb_bitset& o) noexcept {
+    bits |= o.bits;
+    return *this;
+  }
+  constexpr bool operator==(const __veb_bitset& o) const noexcept = default;
+
+ private:
+  word_bitset<(size_t(1) << H) - 1> bits;
+};
+
+// stats_op is the type of operations whose tree walks are counted by a stats policy.
+enum class stats_op {
+  find,        // locating the leaf of a position, for test, set, reset, flip and operator[]
+  update,      // pushing a changed leaf up to the root, for set, reset and flip of a position
+  next,        // first, next, last, prev and pop_first
+  foreach1,    // foreach1
+  count,       // count
+  all,         // all
+  equal,       // == and !=
+  and_assign,  // &= and &
+  or_assign,   // |= and |
+  xor_assign,  // ^= and ^
+  flip,        // flip() and ~
+  reset,       // reset()
+  build,       // construction from a std::bitset
+  to_bitset,   // to_bitset
+  profile,     // profile
+  summary,     // summary of a range
+  intersects,  // intersects
+  andnot,      // andnot
+  or_andnot,   // or_andnot
+  count_and,   // count_and
+};
+inline constexpr size_t N_STATS_OPS = static_cast<size_t>(stats_op::count_and) + 1;
+
+// no_stats is the default stats policy, which counts nothing and costs nothing.
+struct no_stats {
+  static constexpr bool enabled = false;
+  constexpr void visit(stats_op, bool, bool) noexcept {}
+  constexpr void pushup(stats_op) noexcept {}
+};
+
+// counting_stats is a stats policy counting the work of tree walks per operation type, e.g.
+//   segbitset<N, word_bitset, counting_stats> s;
+//   auto c = s.stats()[stats_op::next];  // c.visited, c.pruned, c.leaves, c.pushups
+// Nothing is counted in constant evaluation. It's not thread-safe, even const calls on a segbitset write
+// its counters.
+struct counting_stats {
+  static constexpr bool enabled = true;
+  struct counters {
+    uint64_t visited = 0;  // nodes visited
+    uint64_t pruned = 0;   // subtrees skipped at a visited node
+    uint64_t leaves = 0;   // leaves visited
+    uint64_t pushups = 0;  // nodes recomputed from their children
+  };
+  counters ops[N_STATS_OPS]{};
+
+  constexpr const counters& operator[](stats_op op) const noexcept { return ops[static_cast<size_t>(op)]; }
+  constexpr void visit(stats_op op, bool leaf, bool pruned) noexcept {
+    auto& c = ops[static_cast<size_t>(op)];
+    ++c.visited;
+    c.leaves += leaf;
+    c.pruned += pruned;
+  }
+  constexpr void pushup(stats_op op) noexcept { ++ops[static_cast<size_t>(op)].pushups; }
+};
+
+// adaptive_thresholds are the densities above which bulk operations switch from the pruned tree walk to a
+// flat kernel over the whole storage, which doesn't prune but runs word by word. The density is the fraction
+// of 64-bit blocks having true bits, estimated on a few samples of the summaries (see profile() for exact).
+// Only operations whose flat kernel keeps the summaries exact are adaptive:
+//   or_assign: |= ors the storages, as summaries of an OR are the OR of summaries, on density of the operand.
+//   equal: == compares the storages (confirming differences by the walk).
+//   reset: reset() clears the storage.
+// A threshold of 1 always walks, a negative one always runs flat. Flat kernels are taken only if the storage
+// supports them (word_bitset, veb_bitset, std::bitset), and never in constant evaluation.
+// The defaults were measured on an x86 host, segbitset::calibrate() from segbitset_calibrate.h measures
+// them on yours. They are read by all segbitsets, and not synchronized, so set them before use.
+struct adaptive_thresholds {
+  double or_assign = 0.05;
+  double equal = 0.05;
+  double reset = 0.02;
+};
+inline adaptive_thresholds thresholds;
+
+// A summary policy is a monoid on the bits below a node:
+//   value_type: the summary of a node.
+//   identity(): the summary of no bits.
+//   leaf(bit): the summary of a single bit.
+//   combine(left, right): the summary of two adjacent intervals, left being the lower positions, which
+//     must be associative, but needn't be commutative.
+// e.g. a hash of the bits, or the maximum of a weight per position, plug in without changing segbitset.
+
+// or_summary tells whether any bit below is true. It's the default summary, stored as the tree bits.
+struct or_summary {
+  using value_type = bool;
+  static constexpr bool identity() noexcept { return false; }
+  static constexpr bool leaf(bool bit) noexcept { return bit; }
+  static constexpr bool combine(bool a, bool b) noexcept { return a || b; }
+};
+
+// and_summary tells whether all bits below are true.
+struct and_summary {
+  using value_type = bool;
+  static constexpr bool identity() noexcept { return true; }
+  static constexpr bool leaf(bool bit) noexcept { return bit; }
+  static constexpr bool combine(bool a, bool b) noexcept { return a && b; }
+};
+
+// count_summary counts the true bits below, up to 2^32-1, e.g. for counting bits in a range in O(logN).
+struct count_summary {
+  using value_type = uint32_t;
+  static constexpr uint32_t identity() noexcept { return 0; }
+  static constexpr uint32_t leaf(bool bit) noexcept { return bit; }
+  static constexpr uint32_t combine(uint32_t a, uint32_t b) noexcept { return a + b; }
+};
+
+// zero_run_summary finds the longest run of false bits below, e.g. to find room for a run in allocators.
+struct zero_run_summary {
+  struct value_type {
+    uint32_t size = 0;     // number of bits
+    uint32_t prefix = 0;   // number of false bits at the beginning
+    uint32_t suffix = 0;   // number of false bits at the end
+    uint32_t longest = 0;  // longest run of false bits
+    constexpr bool operator==(const value_type&) const noexcept = default;
+  };
+  static constexpr value_type identity() noexcept { return {}; }
+  static constexpr value_type leaf(bool bit) noexcept {
+    return bit ? value_type{1, 0, 0, 0} : value_type{1, 1, 1, 1};
+  }
+  static constexpr value_type combine(const value_type& a, const value_type& b) noexcept {
+    auto longest = a.suffix + b.prefix;
+    if (a.longest > longest) longest = a.longest;
+    if (b.longest > longest) longest = b.longest;
+    return {a.size + b.size, a.prefix == a.size ? a.size + b.prefix : a.prefix,
+            b.suffix == b.size ? b.size + a.suffix : b.suffix, longest};
+  }
+};
+
+// density_profile tells how the true bits of a segbitset are spread, and so how well the summaries prune,
+// see segbitset::profile().
+struct density_profile {
+  static constexpr size_t BLOCK = 64;  // bits of a leaf block
+  struct level {
+    size_t nodes = 0;    // number of nodes on this level
+    size_t nonzero = 0;  // number of nodes having true bits below
+    // returns the fraction of nodes having true bits below, the lower the more a walk prunes on this level.
+    constexpr double density() const noexcept { return nodes ? double(nonzero) / nodes : 0; }
+  };
+
+  size_t depth = 0;           // number of tree levels
+  level levels[64]{};         // levels[0] is the root, levels[depth - 1] only holds leaves
+  size_t count = 0;           // number of true bits
+  size_t blocks = 0;          // number of leaf blocks, i.e. positions [64k, 64k + 64)
+  size_t nonzero_blocks = 0;  // number of leaf blocks having true bits
+  size_t runs = 0;            // number of maximal runs of consecutive true bits
+  size_t longest_run = 0;     // length of the longest run
+  size_t capacity = 0;        // bits occupied by the tree
+  size_t bytes = 0;           // memory footprint of the segbitset, in bytes
+
+  // returns the average length of runs.
+  constexpr double mean_run() const noexcept { return runs ? double(count) / runs : 0; }
+};
+
+template <size_t N, template <size_t> class Storage = word_bitset, typename Stats = no_stats,
+          typename Summary = or_summary>
 class segbitset {
-  using __segbitset = segbitset<N>;
-  using __bitset = std::bitset<1 + (N << 2)>;  // x4 space, don't use position 0
+  using __segbitset = segbitset<N, Storage, Stats, Summary>;
+  using __bitset = Storage<1 + (N << 2)>;  // x4 space, don't use position 0
 
  public:
   class reference {  // reference to a bit
@@ -56,11 +403,19 @@ class segbitset {
     constexpr reference& flip() noexcept;                       // for b[i].flip();
   };
 
-  constexpr explicit segbitset() noexcept {}
+  using summary_type = typename Summary::value_type;
+
+  constexpr explicit segbitset() noexcept {
+    if constexpr (__augmented) __rebuild_summaries();
+  }
   // creates a segbitset from a std::bitset
   constexpr segbitset(const std::bitset<N>& a) noexcept;  // cppcheck-suppress noExplicitConstructor
   // copy constructor
   constexpr segbitset(const __segbitset& o) noexcept;  // cppcheck-suppress noExplicitConstructor
+  // creates a segbitset from a list of positions of true bits at compile time, e.g. for static lookup tables:
+  //   static constexpr auto digits = segbitset<128>::from_positions({'0', '1', '2', '3', '4'});
+  // fails to compile if any position is out of range.
+  static consteval __segbitset from_positions(std::initializer_list<size_t> positions);
 
   // returns the number of bits that this segbitset holds
   constexpr size_t size() const noexcept { return N; }
@@ -93,24 +448,55 @@ class segbitset {
   // flips the bit at the position pos.
   // throws std::out_of_range if pos is invalid.
   constexpr __segbitset& flip(size_t pos);
+  // sets the bit at position pos to true in a single walk, returns false if it was already true.
+  // throws std::out_of_range if pos is invalid.
+  constexpr bool try_set(size_t pos);
+  // sets the bit at position pos to false in a single walk, returns false if it was already false.
+  // throws std::out_of_range if pos is invalid.
+  constexpr bool try_reset(size_t pos);
   // find the first position where stores a true bit, returns size of this segbitset if not found.
   constexpr size_t first() const noexcept;
   // find the next position where stores a true bit from the right part of given position, returns size of
   // this segbitset if not found.
   constexpr size_t next(size_t pos) const noexcept;
+  // find the last position where stores a true bit, returns size of this segbitset if not found.
+  constexpr size_t last() const noexcept;
+  // find the previous position where stores a true bit from the left part of given position, returns size of
+  // this segbitset if not found. A pos out of range finds the last one.
+  constexpr size_t prev(size_t pos) const noexcept;
+  // finds the first position where stores a true bit and sets it to false, returns the position, or size of
+  // this segbitset if not found.
+  constexpr size_t pop_first() noexcept;
   // iterates all true bits from left to right and execute given callback function,
   // with the position of true bits as a argument.
   // foreach1 should be faster than first & next, since it dosen't require walking from root again.
-  constexpr void foreach1(callback& cb) const noexcept;
+  // cb can be any callable accepting a size_t, e.g. a lambda or a segbitset::callback.
+  template <typename Callback>
+  constexpr void foreach1(Callback&& cb) const noexcept;
+  // like foreach1, but iterates only the true bits in positions [first, last), walking only the subtrees
+  // overlapping the range, e.g. a subtree of subtree_range().
+  // throws std::out_of_range if the range is invalid.
+  template <typename Callback>
+  constexpr void foreach1(size_t first, size_t last, Callback&& cb) const;
+  // returns the positions [first, last) covered by the i-th node from the left at the given depth of the
+  // tree (the root is at depth 0), to split walks at subtree roots. The ranges of i in [0, 2^depth) cover
+  // all positions in order, some are empty where leaves are above the depth.
+  static constexpr std::pair<size_t, size_t> subtree_range(size_t depth, size_t i) noexcept;
   // constructs and returns an equivalent std::bitset from this segbitset.
   constexpr std::bitset<N> to_bitset() const noexcept;
   // fill given std::bitset as an equivalent of this segbitset.
   // the given bitset should be all zero in advance.
   constexpr void to_bitset(std::bitset<N>& a) noexcept;
+  // returns the per-level summary density, leaf blocks, runs and memory footprint of this segbitset.
+  // Walks only the subtrees having true bits, in O(number of nodes having true bits below).
+  constexpr density_profile profile() const noexcept;
 
   constexpr __segbitset& operator=(const __segbitset& o) noexcept;   // copy assign operator
   constexpr bool operator==(const __segbitset& rhs) const noexcept;  // for b == rhs;
   constexpr bool operator!=(const __segbitset& rhs) const noexcept { return !(*this == rhs); }
+  // checks if this and other have a true bit at the same position, like (b & other).any() without a copy.
+  // Walks only the subtrees having true bits in both, and stops at the first common one.
+  constexpr bool intersects(const __segbitset& other) const noexcept;
   // b[pos] returns the value of bit at position pos.
   constexpr bool operator[](size_t pos) const { return test(pos); }
   // b[pos] returns a reference to the bit at position pos.
@@ -119,13 +505,64 @@ class segbitset {
   constexpr __segbitset& operator|=(const __segbitset& other) noexcept;  // for b |= other
   constexpr __segbitset& operator^=(const __segbitset& other) noexcept;  // for b ^= other
   constexpr __segbitset operator~() const noexcept;                      // ~b, returns a copy of flipped b
+  // sets the bits true in other to false, like b &= ~other, but walking only the subtrees having true bits
+  // in both, instead of flipping a copy of other.
+  constexpr __segbitset& andnot(const __segbitset& other) noexcept;
+  // sets the bits true in a and false in b to true, like b |= a & ~other, but walking only the subtrees
+  // having true bits in a, without a copy of a.
+  constexpr __segbitset& or_andnot(const __segbitset& a, const __segbitset& b) noexcept;
+  // returns the number of true bits in common with other, like (b & other).count() without a copy.
+  // Walks only the subtrees having true bits in both.
+  constexpr size_t count_and(const __segbitset& other) const noexcept;
+
+  // returns a snapshot of the counters of tree walks, for a counting Stats policy (see counting_stats).
+  constexpr Stats stats() const noexcept
+    requires Stats::enabled
+  {
+    return __stats;
+  }
+  // resets the counters of tree walks to 0.
+  constexpr void reset_stats() noexcept
+    requires Stats::enabled
+  {
+    __stats = Stats{};
+  }
+
+  // returns the summary of all bits, as of the Summary policy, e.g. the number of true bits on count_summary.
+  constexpr summary_type summary() const noexcept { return __summary(1); }
+  // returns the summary of the bits in positions [first, last), combining O(logN) nodes from left to right.
+  // throws std::out_of_range if the range is invalid.
+  constexpr summary_type summary(size_t first, size_t last) const;
 
  private:
+  // the OR summary is the tree itself, other summaries are stored per node in addition.
+  static constexpr bool __augmented = !std::is_same_v<Summary, or_summary>;
+  struct __no_summaries {};
+  using __summary_array =
+      std::conditional_t<__augmented, std::array<summary_type, 1 + (N << 2)>, __no_summaries>;
+
   __bitset tree;
+  [[no_unique_address]] mutable Stats __stats;
+  [[no_unique_address]] __summary_array __summaries{};
+
+  // returns the summary of node x.
+  constexpr summary_type __summary(size_t x) const noexcept {
+    if constexpr (__augmented)
+      return __summaries[x];
+    else
+      return tree[x];
+  }
+  // updates the summary of leaf x from its bit.
+  constexpr void __leaf(size_t x) noexcept {
+    if constexpr (__augmented) __summaries[x] = Summary::leaf(tree[x]);
+  }
+  // recomputes the summaries of all nodes.
+  constexpr void __rebuild_summaries() noexcept;
 
-  inline constexpr size_t __ls(size_t x) const { return x << 1; }
-  inline constexpr size_t __rs(size_t x) const { return (x << 1) | 1; }
+  static constexpr size_t __ls(size_t x) { return x << 1; }
+  static constexpr size_t __rs(size_t x) { return (x << 1) | 1; }
   constexpr void __pushup(size_t x) noexcept;
+  constexpr void __prefetch(size_t x) const noexcept;
   constexpr void __pushup_to_root(size_t x) noexcept;
   constexpr void __build(const std::bitset<N>& a, size_t l, size_t r, size_t x) noexcept;
   constexpr size_t __count(size_t l, size_t r, size_t x) const noexcept;
@@ -134,73 +571,319 @@ class segbitset {
   constexpr void __flip(size_t l, size_t r, size_t x) noexcept;
   constexpr void __reset(size_t l, size_t r, size_t x) noexcept;
   constexpr bool __equal(const __segbitset& rhs, size_t l, size_t r, size_t x) const noexcept;
+  constexpr bool __intersects(const __segbitset& other, size_t l, size_t r, size_t x) const noexcept;
   constexpr void __copy(const __segbitset& o, size_t l, size_t r, size_t x) noexcept;
   constexpr void __and_assign(const __segbitset& other, size_t l, size_t r, size_t x) noexcept;
   constexpr void __or_assign(const __segbitset& other, size_t l, size_t r, size_t x) noexcept;
   constexpr void __xor_assign(const __segbitset& other, size_t l, size_t r, size_t x) noexcept;
+  constexpr void __andnot(const __segbitset& other, size_t l, size_t r, size_t x) noexcept;
+  constexpr void __or_andnot(const __segbitset& a, const __segbitset& b, size_t l, size_t r,
+                             size_t x) noexcept;
+  constexpr size_t __count_and(const __segbitset& other, size_t l, size_t r, size_t x) const noexcept;
   constexpr void __to_bitset(std::bitset<N>& a, size_t l, size_t r, size_t x) noexcept;
   constexpr void __next(size_t pos, size_t l, size_t r, size_t x, size_t& ans) const noexcept;
-  constexpr void __foreach1(callback& cb, size_t l, size_t r, size_t x) const noexcept;
+  constexpr size_t __prev(size_t pos) const noexcept;
+  template <typename Callback>
+  constexpr void __foreach1(Callback& cb, size_t l, size_t r, size_t x) const noexcept;
+
+  // The top D levels of __find, __next and __foreach1 are unrolled at compile time:
+  // node X and its interval [L, R] are template arguments, so the midpoints are constants,
+  // and the walk falls back to the runtime version once D levels are consumed.
+  static constexpr size_t __unrolled_levels = 5;
+  template <size_t L, size_t R, size_t X, size_t D = __unrolled_levels>
+  constexpr size_t __find(size_t pos) const noexcept;
+  template <size_t L, size_t R, size_t X, size_t D = __unrolled_levels>
+  constexpr void __next(size_t pos, size_t& ans) const noexcept;
+  template <size_t L, size_t R, size_t X, typename Callback, size_t D = __unrolled_levels>
+  constexpr void __foreach1(Callback& cb) const noexcept;
+
+  // __walk is the traversal engine shared by all tree walks, it walks the subtree rooted at node x
+  // covering interval [l, r] in pre-order, and visit(l, r, x) tells what to do with each node:
+  //   __step::descend: goes on to the children (leaves have no children),
+  //   __step::prune: skips the subtree,
+  //   __step::stop: stops the whole walk.
+  // If Pushup is true, each descended inner node is pushed up after its children are walked (except when
+  // stopped). The walk is iterative on an explicit stack, unless SEGBITSET_RECURSIVE_WALK is defined.
+  // Visits and pushups are counted in stats as of operation Op.
+  enum class __step { descend, prune, stop };
+  static constexpr size_t __depth = std::bit_width(N - 1) + 1;  // number of tree levels
+  template <stats_op Op, bool Pushup = false, typename Visit>
+  constexpr bool __walk(size_t l, size_t r, size_t x, Visit&& visit) const noexcept;
+  template <stats_op Op, bool Pushup = false, typename Visit>
+  constexpr bool __walk(size_t l, size_t r, size_t x, Visit&& visit) noexcept;
+
+  // estimates the fraction of 64-bit blocks having true bits, on windows of 64 nodes of the level whose
+  // nodes cover about 64 positions, see adaptive_thresholds.
+  constexpr double __sampled_density() const noexcept;
+  // returns true if the flat kernel should run instead of the walk, for given member of thresholds.
+  constexpr bool __flat(double adaptive_thresholds::*threshold) const noexcept;
+
+  // fires the USDT probe op_entry, returns the visits of op counted so far, to pass to __probe_return.
+  constexpr uint64_t __probe_entry(stats_op op, size_t operand_size) const noexcept;
+  // fires the USDT probe op_return, with the visits of op counted since __probe_entry.
+  constexpr void __probe_return(stats_op op, size_t result, uint64_t visited) const noexcept;
+
+  // counts a visit of node of interval [l, r] (pruned by step) and a pushup, as of operation Op.
+  template <stats_op Op>
+  constexpr void __stat_visit(size_t l, size_t r, __step step) const noexcept {
+    if constexpr (Stats::enabled)
+      if (!std::is_constant_evaluated()) __stats.visit(Op, l == r, step == __step::prune);
+  }
+  template <stats_op Op>
+  constexpr void __stat_pushup() const noexcept {
+    if constexpr (Stats::enabled)
+      if (!std::is_constant_evaluated()) __stats.pushup(Op);
+  }
 
   friend class reference;
 };
 
 ////// Implementation ///////
 
-template <size_t N>
-constexpr void segbitset<N>::__pushup(size_t x) noexcept {
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr void segbitset<N, Storage, Stats, Summary>::__prefetch(size_t x) const noexcept {
+  // Descendants of node x at k levels below are bits [x << k, (x + 1) << k), which are contiguous,
+  // so a single prefetch covers all of them as long as 2^k bits fit in a cache line.
+  if constexpr (SEGBITSET_PREFETCH_DISTANCE > 0 && requires { tree.prefetch(x); }) {
+    if (auto y = x << SEGBITSET_PREFETCH_DISTANCE; y < tree.size()) tree.prefetch(y);
+  }
+}
+
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr double segbitset<N, Storage, Stats, Summary>::__sampled_density() const noexcept {
+  // levels above the last two are complete, so nodes of level k are positions [2^k, 2^(k+1)).
+  constexpr size_t k = __depth > 7 ? __depth - 7 : 0, width = size_t(1) << k;
+  constexpr size_t windows = width > 256 ? 4 : 1, span = width > 256 ? 64 : width;
+  size_t nonzero = 0;
+  for (size_t w = 0; w < windows; w++) {
+    auto x = width + w * (width / windows);
+    for (size_t i = 0; i < span; i++) nonzero += tree[x + i];
+  }
+  return double(nonzero) / double(windows * span);
+}
+
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr bool segbitset<N, Storage, Stats, Summary>::__flat(
+    double adaptive_thresholds::*threshold) const noexcept {
+  if (std::is_constant_evaluated()) return false;  // thresholds aren't constants
+  if constexpr (__augmented) return false;         // flat kernels don't maintain the stored summaries
+  auto t = thresholds.*threshold;
+  if (t >= 1) return false;
+  return t < 0 || __sampled_density() > t;
+}
+
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr uint64_t segbitset<N, Storage, Stats, Summary>::__probe_entry(stats_op op,
+                                                                        size_t operand_size) const noexcept {
+#ifdef SEGBITSET_USDT
+  if (!std::is_constant_evaluated()) {
+    DTRACE_PROBE3(segbitset, op_entry, static_cast<int>(op), N, operand_size);
+    if constexpr (requires { __stats[op].visited; }) return __stats[op].visited;
+  }
+#else
+  (void)op, (void)operand_size;
+#endif
+  return 0;
+}
+
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr void segbitset<N, Storage, Stats, Summary>::__probe_return(stats_op op, size_t result,
+                                                                     uint64_t visited) const noexcept {
+#ifdef SEGBITSET_USDT
+  if (!std::is_constant_evaluated()) {
+    if constexpr (requires { __stats[op].visited; }) visited = __stats[op].visited - visited;
+    DTRACE_PROBE4(segbitset, op_return, static_cast<int>(op), N, result, visited);
+  }
+#else
+  (void)op, (void)result, (void)visited;
+#endif
+}
+
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+template <stats_op Op, bool Pushup, typename Visit>
+constexpr bool segbitset<N, Storage, Stats, Summary>::__walk(size_t l, size_t r, size_t x,
+                                                             Visit&& visit) const noexcept {
+  static_assert(!Pushup, "pushup walks require a non-const segbitset");
+#ifdef SEGBITSET_RECURSIVE_WALK
+  auto step = visit(l, r, x);
+  __stat_visit<Op>(l, r, step);
+  if (step == __step::stop) return false;
+  if (step == __step::prune || l == r) return true;
+  __prefetch(x);
+  auto m = (l + r) >> 1;
+  return __walk<Op>(l, m, __ls(x), visit) && __walk<Op>(m + 1, r, __rs(x), visit);
+#else
+  struct {
+    size_t l, r, x;
+  } stack[__depth];  // pending right siblings
+  size_t top = 0;
+  while (true) {
+    auto step = visit(l, r, x);
+    __stat_visit<Op>(l, r, step);
+    if (step == __step::stop) return false;
+    if (step == __step::descend && l != r) {
+      __prefetch(x);
+      auto m = (l + r) >> 1;
+      stack[top++] = {m + 1, r, __rs(x)};
+      r = m, x = __ls(x);
+      continue;
+    }
+    if (!top) return true;
+    auto& f = stack[--top];
+    l = f.l, r = f.r, x = f.x;
+  }
+#endif
+}
+
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+template <stats_op Op, bool Pushup, typename Visit>
+constexpr bool segbitset<N, Storage, Stats, Summary>::__walk(size_t l, size_t r, size_t x,
+                                                             Visit&& visit) noexcept {
+  if constexpr (!Pushup) {
+    return std::as_const(*this).template __walk<Op>(l, r, x, visit);
+  } else {
+#ifdef SEGBITSET_RECURSIVE_WALK
+    auto step = visit(l, r, x);
+    __stat_visit<Op>(l, r, step);
+    if (step == __step::stop) return false;
+    if (l == r) __leaf(x);
+    if (step == __step::prune || l == r) return true;
+    __prefetch(x);
+    auto m = (l + r) >> 1;
+    if (!__walk<Op, true>(l, m, __ls(x), visit) || !__walk<Op, true>(m + 1, r, __rs(x), visit)) return false;
+    __pushup(x);
+    __stat_pushup<Op>();
+    return true;
+#else
+    struct {
+      size_t l, r, x;  // l == 0 marks a pending pushup of node x, since intervals start from 1.
+    } stack[__depth << 1];  // pending right siblings and pushups
+    size_t top = 0;
+    while (true) {
+      auto step = visit(l, r, x);
+      __stat_visit<Op>(l, r, step);
+      if (step == __step::stop) return false;
+      if (l == r) __leaf(x);
+      if (step == __step::descend && l != r) {
+        __prefetch(x);
+        auto m = (l + r) >> 1;
+        stack[top++] = {0, 0, x};
+        stack[top++] = {m + 1, r, __rs(x)};
+        r = m, x = __ls(x);
+        continue;
+      }
+      while (true) {  // pops the next pending subtree, doing pushups on the way.
+        if (!top) return true;
+        auto& f = stack[--top];
+        if (f.l) {
+          l = f.l, r = f.r, x = f.x;
+          break;
+        }
+        __pushup(f.x);
+        __stat_pushup<Op>();
+      }
+    }
+#endif
+  }
+}
+
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr void segbitset<N, Storage, Stats, Summary>::__pushup(size_t x) noexcept {
   tree[x] = tree[__ls(x)] | tree[__rs(x)];
+  if constexpr (__augmented) __summaries[x] = Summary::combine(__summaries[__ls(x)], __summaries[__rs(x)]);
 }
 
-template <size_t N>
-constexpr void segbitset<N>::__pushup_to_root(size_t x) noexcept {
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr void segbitset<N, Storage, Stats, Summary>::__pushup_to_root(size_t x) noexcept {
   while (x) {
-    tree[x] = tree[__ls(x)] | tree[__rs(x)];
+    __pushup(x);
+    __stat_pushup<stats_op::update>();
     x >>= 1;
   }
 }
 
-template <size_t N>
-constexpr void segbitset<N>::__build(const std::bitset<N>& a, size_t l, size_t r, size_t x) noexcept {
-  if (l == r) {
-    tree[x] = a[l - 1];
-    return;
-  }
-  auto m = (l + r) >> 1;
-  __build(a, l, m, __ls(x));
-  __build(a, m + 1, r, __rs(x));
-  __pushup(x);
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr void segbitset<N, Storage, Stats, Summary>::__rebuild_summaries() noexcept {
+  __walk<stats_op::build, true>(1, N, 1, [](size_t, size_t, size_t) { return __step::descend; });
+}
+
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr typename segbitset<N, Storage, Stats, Summary>::summary_type
+segbitset<N, Storage, Stats, Summary>::summary(size_t first, size_t last) const {
+  if (last > N || first > last) throw std::out_of_range("segbitset::summary invalid range");
+  auto acc = Summary::identity();
+  // nodes covered by [first+1, last] are combined in order from left to right, since the walk is preorder.
+  __walk<stats_op::summary>(1, N, 1, [&](size_t l, size_t r, size_t x) {
+    if (r <= first || l > last) return __step::prune;
+    if (first < l && r <= last) {
+      acc = Summary::combine(acc, __summary(x));
+      return __step::prune;
+    }
+    return __step::descend;
+  });
+  return acc;
+}
+
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr void segbitset<N, Storage, Stats, Summary>::__build(const std::bitset<N>& a, size_t l, size_t r,
+                                                              size_t x) noexcept {
+  __walk<stats_op::build, true>(l, r, x, [&](size_t l, size_t r, size_t x) {
+    if (l == r) tree[x] = a[l - 1];
+    return __step::descend;
+  });
 }
 
-template <size_t N>
-constexpr segbitset<N>::segbitset(const std::bitset<N>& a) noexcept {
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr segbitset<N, Storage, Stats, Summary>::segbitset(const std::bitset<N>& a) noexcept {
+  auto v = __probe_entry(stats_op::build, N);
   __build(a, 1, N, 1);
+  __probe_return(stats_op::build, 0, v);
 }
 
-template <size_t N>
-constexpr segbitset<N>::segbitset(const __segbitset& o) noexcept : tree(o.tree) {}
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr segbitset<N, Storage, Stats, Summary>::segbitset(const __segbitset& o) noexcept
+    : tree(o.tree), __summaries(o.__summaries) {}
 
-template <size_t N>
-constexpr segbitset<N>& segbitset<N>::operator=(const __segbitset& o) noexcept {
-  if (&o != this) tree = o.tree;
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr segbitset<N, Storage, Stats, Summary>& segbitset<N, Storage, Stats, Summary>::operator=(
+    const __segbitset& o) noexcept {
+  if (&o != this) tree = o.tree, __summaries = o.__summaries;
+  return *this;
 }
 
-template <size_t N>
-constexpr size_t segbitset<N>::__count(size_t l, size_t r, size_t x) const noexcept {
-  if (!tree[x]) return 0;
-  if (l == r) return 1;
-  auto m = (l + r) >> 1;
-  return __count(l, m, __ls(x)) + __count(m + 1, r, __rs(x));
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+consteval segbitset<N, Storage, Stats, Summary> segbitset<N, Storage, Stats, Summary>::from_positions(
+    std::initializer_list<size_t> positions) {
+  __segbitset s;
+  for (auto pos : positions) s.set(pos);
+  return s;
 }
 
-template <size_t N>
-constexpr size_t segbitset<N>::count() const noexcept {
-  return __count(1, N, 1);
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr size_t segbitset<N, Storage, Stats, Summary>::__count(size_t l, size_t r, size_t x) const noexcept {
+  size_t n = 0;
+  __walk<stats_op::count>(l, r, x, [&](size_t l, size_t r, size_t x) {
+    if (!tree[x]) return __step::prune;
+    if (l == r) ++n;
+    return __step::descend;
+  });
+  return n;
 }
 
-template <size_t N>
-constexpr size_t segbitset<N>::__find(size_t pos, size_t l, size_t r, size_t x) const noexcept {
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr size_t segbitset<N, Storage, Stats, Summary>::count() const noexcept {
+  auto v = __probe_entry(stats_op::count, 0);
+  auto n = __count(1, N, 1);
+  __probe_return(stats_op::count, n, v);
+  return n;
+}
+
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr size_t segbitset<N, Storage, Stats, Summary>::__find(size_t pos, size_t l, size_t r,
+                                                               size_t x) const noexcept {
   while (l != r) {
+    __stat_visit<stats_op::find>(l, r, __step::descend);
+    __prefetch(x);
     auto m = (l + r) >> 1;
     if (pos <= m) {
       r = m;
@@ -210,317 +893,651 @@ constexpr size_t segbitset<N>::__find(size_t pos, size_t l, size_t r, size_t x)
       x = __rs(x);
     }
   }
+  __stat_visit<stats_op::find>(l, r, __step::descend);
   return x;
 }
 
-template <size_t N>
-constexpr bool segbitset<N>::test(size_t pos) const {
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+template <size_t L, size_t R, size_t X, size_t D>
+constexpr size_t segbitset<N, Storage, Stats, Summary>::__find(size_t pos) const noexcept {
+  if constexpr (L == R) {
+    __stat_visit<stats_op::find>(L, R, __step::descend);
+    return X;
+  } else if constexpr (D == 0) {
+    return __find(pos, L, R, X);
+  } else {
+    __stat_visit<stats_op::find>(L, R, __step::descend);
+    constexpr size_t M = (L + R) >> 1;
+    if (pos <= M) return __find<L, M, __ls(X), D - 1>(pos);
+    return __find<M + 1, R, __rs(X), D - 1>(pos);
+  }
+}
+
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr bool segbitset<N, Storage, Stats, Summary>::test(size_t pos) const {
   if (pos >= N) throw std::out_of_range("segbitset::test pos >= N");
-  return tree[__find(pos + 1, 1, N, 1)];
+  return tree[__find<1, N, 1>(pos + 1)];
 }
 
-template <size_t N>
-constexpr bool segbitset<N>::__all(size_t l, size_t r, size_t x) const noexcept {
-  if (!tree[x]) return false;
-  if (l == r) return tree[x];
-  auto m = (l + r) >> 1;
-  return __all(l, m, __ls(x)) && __all(m + 1, r, __rs(x));  // && has short circuit effect
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr bool segbitset<N, Storage, Stats, Summary>::__all(size_t l, size_t r, size_t x) const noexcept {
+  return __walk<stats_op::all>(
+      l, r, x, [&](size_t, size_t, size_t x) { return tree[x] ? __step::descend : __step::stop; });
 }
 
-template <size_t N>
-constexpr bool segbitset<N>::all() const noexcept {
-  return __all(1, N, 1);
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr bool segbitset<N, Storage, Stats, Summary>::all() const noexcept {
+  auto v = __probe_entry(stats_op::all, 0);
+  auto ans = __all(1, N, 1);
+  __probe_return(stats_op::all, ans, v);
+  return ans;
 }
 
-template <size_t N>
-constexpr bool segbitset<N>::any() const noexcept {
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr bool segbitset<N, Storage, Stats, Summary>::any() const noexcept {
   return tree[1];  // root == 1 indicates the whole tree contains true bits
 }
 
-template <size_t N>
-constexpr bool segbitset<N>::none() const noexcept {
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr bool segbitset<N, Storage, Stats, Summary>::none() const noexcept {
   return !tree[1];  // root == 0 indicates the whole tree contains no true bits
 }
 
-template <size_t N>
-constexpr segbitset<N>& segbitset<N>::set() noexcept {
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr segbitset<N, Storage, Stats, Summary>& segbitset<N, Storage, Stats, Summary>::set() noexcept {
   tree.set();  // TODO: any faster solution?
+  if constexpr (__augmented) __rebuild_summaries();
   return *this;
 }
 
-template <size_t N>
-constexpr segbitset<N>& segbitset<N>::set(size_t pos, bool value) {
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr segbitset<N, Storage, Stats, Summary>&
+segbitset<N, Storage, Stats, Summary>::set(size_t pos, bool value) {
   if (pos >= N) throw std::out_of_range("segbitset::set pos >= N");
-  auto x = __find(pos + 1, 1, N, 1);
-  tree[x] = 1;
+  auto x = __find<1, N, 1>(pos + 1);
+  tree[x] = value;
+  __leaf(x);
   __pushup_to_root(x >> 1);
   return *this;
 }
 
-template <size_t N>
-constexpr void segbitset<N>::__reset(size_t l, size_t r, size_t x) noexcept {
-  if (!tree[x]) return;  // won't change
-  if (l == r) {
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr void segbitset<N, Storage, Stats, Summary>::__reset(size_t l, size_t r, size_t x) noexcept {
+  // the whole subtree is going to be all 0, no pushup required, except for the stored summaries.
+  __walk<stats_op::reset, __augmented>(l, r, x, [&](size_t, size_t, size_t x) {
+    if (!tree[x]) return __step::prune;  // won't change
     tree[x] = 0;
-    return;
-  }
-  auto m = (l + r) >> 1;
-  __reset(l, m, __ls(x));
-  __reset(m + 1, r, __rs(x));
-  __pushup(x);
+    return __step::descend;
+  });
 }
 
-template <size_t N>
-constexpr segbitset<N>& segbitset<N>::reset() noexcept {
-  // Not using tree.reset() (aka std::bitset's)
-  // for hoping better performance on sparse dataset.
-  // TODO: performance
-  __reset(1, N, 1);
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr segbitset<N, Storage, Stats, Summary>& segbitset<N, Storage, Stats, Summary>::reset() noexcept {
+  // Walks to clear only the true bits on sparse sets, clears the whole storage on dense sets.
+  auto v = __probe_entry(stats_op::reset, 0);
+  if (__flat(&adaptive_thresholds::reset))
+    tree.reset();
+  else
+    __reset(1, N, 1);
+  __probe_return(stats_op::reset, 0, v);
   return *this;
 }
 
-template <size_t N>
-constexpr segbitset<N>& segbitset<N>::reset(size_t pos) {
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr segbitset<N, Storage, Stats, Summary>& segbitset<N, Storage, Stats, Summary>::reset(size_t pos) {
   if (pos >= N) throw std::out_of_range("segbitset::reset pos >= N");
-  auto x = __find(pos + 1, 1, N, 1);
+  auto x = __find<1, N, 1>(pos + 1);
   tree[x] = 0;
+  __leaf(x);
   __pushup_to_root(x >> 1);
   return *this;
 }
 
-template <size_t N>
-constexpr void segbitset<N>::__flip(size_t l, size_t r, size_t x) noexcept {
-  if (l == r) {
-    tree[x] = !tree[x];
-    return;
-  }
-  auto m = (l + r) >> 1;
-  __flip(l, m, __ls(x));
-  __flip(m + 1, r, __rs(x));
-  __pushup(x);
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr void segbitset<N, Storage, Stats, Summary>::__flip(size_t l, size_t r, size_t x) noexcept {
+  __walk<stats_op::flip, true>(l, r, x, [&](size_t l, size_t r, size_t x) {
+    if (l == r) tree[x] = !tree[x];
+    return __step::descend;
+  });
 }
 
-template <size_t N>
-constexpr segbitset<N>& segbitset<N>::flip() noexcept {
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr segbitset<N, Storage, Stats, Summary>& segbitset<N, Storage, Stats, Summary>::flip() noexcept {
+  auto v = __probe_entry(stats_op::flip, 0);
   __flip(1, N, 1);
+  __probe_return(stats_op::flip, 0, v);
   return *this;
 }
 
-template <size_t N>
-constexpr segbitset<N>& segbitset<N>::flip(size_t pos) {
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr segbitset<N, Storage, Stats, Summary>& segbitset<N, Storage, Stats, Summary>::flip(size_t pos) {
   if (pos >= N) throw std::out_of_range("segbitset::flip pos >= N");
-  auto x = __find(pos + 1, 1, N, 1);
+  auto x = __find<1, N, 1>(pos + 1);
   tree[x] = !tree[x];
+  __leaf(x);
   __pushup_to_root(x >> 1);
   return *this;
 }
 
-template <size_t N>
-constexpr bool segbitset<N>::__equal(const segbitset<N>& rhs, size_t l, size_t r, size_t x) const noexcept {
-  if (tree[x] != rhs.tree[x]) return false;
-  if (!tree[x] && !rhs.tree[x]) return true;  // children of both are all 0.
-  if (l == r) return true;
-  auto m = (l + r) >> 1;
-  return __equal(rhs, l, m, __ls(x)) && __equal(rhs, r, m + 1, __rs(x));
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr bool segbitset<N, Storage, Stats, Summary>::try_set(size_t pos) {
+  if (pos >= N) throw std::out_of_range("segbitset::try_set pos >= N");
+  auto x = __find<1, N, 1>(pos + 1);
+  if (tree[x]) return false;
+  tree[x] = 1;
+  __leaf(x);
+  __pushup_to_root(x >> 1);
+  return true;
+}
+
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr bool segbitset<N, Storage, Stats, Summary>::try_reset(size_t pos) {
+  if (pos >= N) throw std::out_of_range("segbitset::try_reset pos >= N");
+  auto x = __find<1, N, 1>(pos + 1);
+  if (!tree[x]) return false;
+  tree[x] = 0;
+  __leaf(x);
+  __pushup_to_root(x >> 1);
+  return true;
+}
+
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr bool segbitset<N, Storage, Stats, Summary>::__equal(const __segbitset& rhs, size_t l, size_t r,
+                                                              size_t x) const noexcept {
+  return __walk<stats_op::equal>(l, r, x, [&](size_t, size_t, size_t x) {
+    if (tree[x] != rhs.tree[x]) return __step::stop;
+    if (!tree[x]) return __step::prune;  // children of both are all 0.
+    rhs.__prefetch(x);
+    return __step::descend;
+  });
 }
 
-template <size_t N>
-constexpr bool segbitset<N>::operator==(const segbitset<N>& rhs) const noexcept {
-  return __equal(rhs, 1, N, 1);
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr bool segbitset<N, Storage, Stats, Summary>::operator==(const __segbitset& rhs) const noexcept {
+  auto v = __probe_entry(stats_op::equal, N);
+  bool ans = false;
+  // set() fills the positions out of the tree too, so a difference of storages is confirmed by the walk.
+  if constexpr (requires { tree == rhs.tree; })
+    ans = tree[1] == rhs.tree[1] && __flat(&adaptive_thresholds::equal) && tree == rhs.tree;
+  if (!ans) ans = __equal(rhs, 1, N, 1);
+  __probe_return(stats_op::equal, ans, v);
+  return ans;
 }
 
-template <size_t N>
-constexpr void segbitset<N>::__and_assign(const __segbitset& other, size_t l, size_t r, size_t x) noexcept {
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr bool segbitset<N, Storage, Stats, Summary>::__intersects(const __segbitset& other, size_t l,
+                                                                   size_t r, size_t x) const noexcept {
+  // stops at the first leaf true in both, the walk returns false then.
+  return !__walk<stats_op::intersects>(l, r, x, [&](size_t l, size_t r, size_t x) {
+    if (!tree[x] || !other.tree[x]) return __step::prune;  // no common true bits below.
+    if (l == r) return __step::stop;
+    other.__prefetch(x);
+    return __step::descend;
+  });
+}
+
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr bool segbitset<N, Storage, Stats, Summary>::intersects(const __segbitset& other) const noexcept {
+  auto v = __probe_entry(stats_op::intersects, N);
+  auto ans = __intersects(other, 1, N, 1);
+  __probe_return(stats_op::intersects, ans, v);
+  return ans;
+}
+
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr void segbitset<N, Storage, Stats, Summary>::__and_assign(const __segbitset& other, size_t l,
+                                                                   size_t r, size_t x) noexcept {
   // 0 & 0 -> 0   *
   // 0 & 1 -> 0   *
   // 1 & 0 -> 0
   // 1 & 1 -> 1
   // if children of this tree are all zeros, results won't change.
-  if (!tree[x]) return;
-  if (l == r) {
-    tree[x] = tree[x] & other.tree[x];
-    return;
-  }
-  auto m = (l + r) >> 1;
-  __and_assign(other, l, m, __ls(x));
-  __and_assign(other, m + 1, r, __rs(x));
-  __pushup(x);
+  __walk<stats_op::and_assign, true>(l, r, x, [&](size_t l, size_t r, size_t x) {
+    if (!tree[x]) return __step::prune;
+    if (l == r) tree[x] = other.tree[x];
+    other.__prefetch(x);
+    return __step::descend;
+  });
 }
 
-template <size_t N>
-constexpr segbitset<N>& segbitset<N>::operator&=(const segbitset<N>& other) noexcept {
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr segbitset<N, Storage, Stats, Summary>& segbitset<N, Storage, Stats, Summary>::operator&=(
+    const __segbitset& other) noexcept {
+  auto v = __probe_entry(stats_op::and_assign, N);
   __and_assign(other, 1, N, 1);
+  __probe_return(stats_op::and_assign, 0, v);
   return *this;
 }
 
-template <size_t N>
-constexpr void segbitset<N>::__or_assign(const __segbitset& other, size_t l, size_t r, size_t x) noexcept {
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr void segbitset<N, Storage, Stats, Summary>::__or_assign(const __segbitset& other, size_t l,
+                                                                  size_t r, size_t x) noexcept {
   // 0 | 0 -> 0   *
   // 0 | 1 -> 1
   // 1 | 0 -> 1   *
   // 1 | 1 -> 1
   // if children of other are all of 0, results of this tree won't change.
-  if (!other.tree[x]) return;
-  if (l == r) {
-    tree[x] = tree[x] | other.tree[x];
-    return;
-  }
-  auto m = (l + r) >> 1;
-  __or_assign(other, l, m, __ls(x));
-  __or_assign(other, m + 1, r, __rs(x));
-  __pushup(x);
+  __walk<stats_op::or_assign, true>(l, r, x, [&](size_t l, size_t r, size_t x) {
+    if (!other.tree[x]) return __step::prune;
+    if (l == r) tree[x] = 1;
+    other.__prefetch(x);
+    return __step::descend;
+  });
 }
 
-template <size_t N>
-constexpr segbitset<N>& segbitset<N>::operator|=(const segbitset<N>& other) noexcept {
-  __or_assign(other, 1, N, 1);
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr segbitset<N, Storage, Stats, Summary>& segbitset<N, Storage, Stats, Summary>::operator|=(
+    const __segbitset& other) noexcept {
+  auto v = __probe_entry(stats_op::or_assign, N);
+  if constexpr (requires { tree |= other.tree; }) {
+    if (other.__flat(&adaptive_thresholds::or_assign))
+      tree |= other.tree;
+    else
+      __or_assign(other, 1, N, 1);
+  } else {
+    __or_assign(other, 1, N, 1);
+  }
+  __probe_return(stats_op::or_assign, 0, v);
   return *this;
 }
 
-template <size_t N>
-constexpr void segbitset<N>::__xor_assign(const __segbitset& other, size_t l, size_t r, size_t x) noexcept {
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr void segbitset<N, Storage, Stats, Summary>::__xor_assign(const __segbitset& other, size_t l,
+                                                                   size_t r, size_t x) noexcept {
   // 0 ^ 0 -> 0    *
   // 0 ^ 1 -> 1
   // 1 ^ 0 -> 1    *
   // 1 ^ 1 -> 0
   // if children of other are all 0, tree won't change.
-  if (!other.tree[x]) return;
-  if (l == r) {
-    tree[x] = tree[x] ^ other.tree[x];
-    return;
-  }
-  auto m = (l + r) >> 1;
-  __xor_assign(other, l, m, __ls(x));
-  __xor_assign(other, m + 1, r, __rs(x));
-  __pushup(x);
+  __walk<stats_op::xor_assign, true>(l, r, x, [&](size_t l, size_t r, size_t x) {
+    if (!other.tree[x]) return __step::prune;
+    if (l == r) tree[x] = !tree[x];
+    other.__prefetch(x);
+    return __step::descend;
+  });
 }
 
-template <size_t N>
-constexpr segbitset<N>& segbitset<N>::operator^=(const __segbitset& other) noexcept {
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr segbitset<N, Storage, Stats, Summary>& segbitset<N, Storage, Stats, Summary>::operator^=(
+    const __segbitset& other) noexcept {
+  auto v = __probe_entry(stats_op::xor_assign, N);
   __xor_assign(other, 1, N, 1);
+  __probe_return(stats_op::xor_assign, 0, v);
   return *this;
 }
 
-template <size_t N>
-constexpr segbitset<N> segbitset<N>::operator~() const noexcept {
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr void segbitset<N, Storage, Stats, Summary>::__andnot(const __segbitset& other, size_t l, size_t r,
+                                                              size_t x) noexcept {
+  // 0 & ~0 -> 0   *
+  // 0 & ~1 -> 0   *
+  // 1 & ~0 -> 1   *
+  // 1 & ~1 -> 0
+  // only subtrees having true bits in both may change.
+  __walk<stats_op::andnot, true>(l, r, x, [&](size_t l, size_t r, size_t x) {
+    if (!tree[x] || !other.tree[x]) return __step::prune;
+    if (l == r) tree[x] = 0;
+    other.__prefetch(x);
+    return __step::descend;
+  });
+}
+
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr segbitset<N, Storage, Stats, Summary>& segbitset<N, Storage, Stats, Summary>::andnot(
+    const __segbitset& other) noexcept {
+  auto v = __probe_entry(stats_op::andnot, N);
+  __andnot(other, 1, N, 1);
+  __probe_return(stats_op::andnot, 0, v);
+  return *this;
+}
+
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr void segbitset<N, Storage, Stats, Summary>::__or_andnot(const __segbitset& a, const __segbitset& b,
+                                                                  size_t l, size_t r, size_t x) noexcept {
+  // this | (a & ~b), only subtrees having true bits in a may change.
+  __walk<stats_op::or_andnot, true>(l, r, x, [&](size_t l, size_t r, size_t x) {
+    if (!a.tree[x]) return __step::prune;
+    if (l == r && !b.tree[x]) tree[x] = 1;
+    a.__prefetch(x);
+    b.__prefetch(x);
+    return __step::descend;
+  });
+}
+
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr segbitset<N, Storage, Stats, Summary>& segbitset<N, Storage, Stats, Summary>::or_andnot(
+    const __segbitset& a, const __segbitset& b) noexcept {
+  auto v = __probe_entry(stats_op::or_andnot, N);
+  __or_andnot(a, b, 1, N, 1);
+  __probe_return(stats_op::or_andnot, 0, v);
+  return *this;
+}
+
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr size_t segbitset<N, Storage, Stats, Summary>::__count_and(const __segbitset& other, size_t l,
+                                                                    size_t r, size_t x) const noexcept {
+  size_t n = 0;
+  __walk<stats_op::count_and>(l, r, x, [&](size_t l, size_t r, size_t x) {
+    if (!tree[x] || !other.tree[x]) return __step::prune;  // no common true bits below.
+    if (l == r) ++n;
+    other.__prefetch(x);
+    return __step::descend;
+  });
+  return n;
+}
+
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr size_t segbitset<N, Storage, Stats, Summary>::count_and(const __segbitset& other) const noexcept {
+  auto v = __probe_entry(stats_op::count_and, N);
+  auto n = __count_and(other, 1, N, 1);
+  __probe_return(stats_op::count_and, n, v);
+  return n;
+}
+
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr segbitset<N, Storage, Stats, Summary>
+segbitset<N, Storage, Stats, Summary>::operator~() const noexcept {
   auto clone = *this;
   clone.flip();  // inplace
   return clone;
 }
 
-template <size_t N>
-constexpr void segbitset<N>::__to_bitset(std::bitset<N>& a, size_t l, size_t r, size_t x) noexcept {
-  if (l == r) {
-    a[l - 1] = tree[x];
-    return;
-  }
-
-  auto m = (l + r) >> 1;
-  __to_bitset(a, l, m, __ls(x));
-  __to_bitset(a, m + 1, r, __rs(x));
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr void segbitset<N, Storage, Stats, Summary>::__to_bitset(std::bitset<N>& a, size_t l, size_t r,
+                                                                  size_t x) noexcept {
+  // a is all 0 in advance, so only subtrees containing true bits are walked.
+  __walk<stats_op::to_bitset>(l, r, x, [&](size_t l, size_t r, size_t x) {
+    if (!tree[x]) return __step::prune;
+    if (l == r) a[l - 1] = 1;
+    return __step::descend;
+  });
 }
 
-template <size_t N>
-constexpr std::bitset<N> segbitset<N>::to_bitset() const noexcept {
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr std::bitset<N> segbitset<N, Storage, Stats, Summary>::to_bitset() const noexcept {
   std::bitset<N> a;
   auto self = const_cast<__segbitset*>(this);
-  self->__to_bitset(a, 1, N, 1);
+  self->to_bitset(a);
   return a;
 }
 
-template <size_t N>
-constexpr void segbitset<N>::to_bitset(std::bitset<N>& a) noexcept {
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr void segbitset<N, Storage, Stats, Summary>::to_bitset(std::bitset<N>& a) noexcept {
+  auto v = __probe_entry(stats_op::to_bitset, N);
   __to_bitset(a, 1, N, 1);
+  __probe_return(stats_op::to_bitset, 0, v);
 }
 
-template <size_t N>
-constexpr void segbitset<N>::__next(size_t pos, size_t l, size_t r, size_t x, size_t& ans) const noexcept {
-  if (!tree[x]) return;
-  if (r < pos) return;  // skip previously scanned intervals.
-  if (l == r) {
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr density_profile segbitset<N, Storage, Stats, Summary>::profile() const noexcept {
+  auto v = __probe_entry(stats_op::profile, 0);
+  density_profile p;
+  p.depth = __depth;
+  p.blocks = (N + density_profile::BLOCK - 1) / density_profile::BLOCK;
+  p.capacity = capacity();
+  p.bytes = sizeof(*this);
+  // Nodes of a level cover intervals of at most two distinct sizes, s and s + 1 (aka halves of the
+  // previous level), so the number of nodes per level is counted on sizes, not nodes.
+  size_t s = N, ns = 1, ns1 = 0;  // ns intervals of size s, ns1 of size s + 1
+  for (size_t d = 0; d < __depth; d++) {
+    p.levels[d].nodes = ns + ns1;
+    size_t t = s >> 1, nt = 0, nt1 = 0;  // halves of the next level: t or t + 1
+    auto split = [&](size_t size, size_t n) {
+      if (size < 2) return;  // leaves have no children
+      for (auto h : {size >> 1, (size + 1) >> 1}) (h == t ? nt : nt1) += n;
+    };
+    split(s, ns), split(s + 1, ns1);
+    s = t, ns = nt, ns1 = nt1;
+  }
+  size_t last = 0, run = 0;  // 1-based position of the last true bit, and length of its run
+  __walk<stats_op::profile>(1, N, 1, [&](size_t l, size_t r, size_t x) {
+    if (!tree[x]) return __step::prune;
+    ++p.levels[std::bit_width(x) - 1].nonzero;
+    if (l != r) return __step::descend;
+    // leaves are visited from left to right.
+    ++p.count;
+    if (!last || (l - 1) / density_profile::BLOCK != (last - 1) / density_profile::BLOCK) ++p.nonzero_blocks;
+    run = (last && l == last + 1) ? run + 1 : 1;
+    if (run == 1) ++p.runs;
+    if (run > p.longest_run) p.longest_run = run;
+    last = l;
+    return __step::descend;
+  });
+  __probe_return(stats_op::profile, p.count, v);
+  return p;
+}
+
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr void segbitset<N, Storage, Stats, Summary>::__next(size_t pos, size_t l, size_t r, size_t x,
+                                                             size_t& ans) const noexcept {
+  __walk<stats_op::next>(l, r, x, [&](size_t l, size_t r, size_t x) {
+    if (!tree[x]) return __step::prune;
+    if (r < pos) return __step::prune;  // skip previously scanned intervals.
+    if (l != r) return __step::descend;
     ans = l;
-    return;
+    return __step::stop;
+  });
+}
+
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+template <size_t L, size_t R, size_t X, size_t D>
+constexpr void segbitset<N, Storage, Stats, Summary>::__next(size_t pos, size_t& ans) const noexcept {
+  if constexpr (L == R || D == 0) {
+    __next(pos, L, R, X, ans);
+  } else {
+    if (!tree[X] || R < pos) {  // skip previously scanned intervals.
+      __stat_visit<stats_op::next>(L, R, __step::prune);
+      return;
+    }
+    __stat_visit<stats_op::next>(L, R, __step::descend);
+    constexpr size_t M = (L + R) >> 1;
+    if (!ans && tree[__ls(X)]) __next<L, M, __ls(X), D - 1>(pos, ans);
+    if (!ans && tree[__rs(X)]) __next<M + 1, R, __rs(X), D - 1>(pos, ans);
   }
-  auto m = (l + r) >> 1;
-  auto lx = __ls(x), rx = __rs(x);
-  if (!ans && tree[lx]) __next(pos, l, m, lx, ans);
-  if (!ans && tree[rx]) __next(pos, m + 1, r, rx, ans);
 }
 
-template <size_t N>
-constexpr size_t segbitset<N>::first() const noexcept {
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr size_t segbitset<N, Storage, Stats, Summary>::first() const noexcept {
+  auto v = __probe_entry(stats_op::next, 0);
   size_t ans = 0;
-  __next(1, 1, N, 1, ans);
-  return ans ? (ans - 1) : N;
+  __next<1, N, 1>(1, ans);
+  ans = ans ? (ans - 1) : N;
+  __probe_return(stats_op::next, ans, v);
+  return ans;
 }
 
-template <size_t N>
-constexpr size_t segbitset<N>::next(size_t pos) const noexcept {
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr size_t segbitset<N, Storage, Stats, Summary>::next(size_t pos) const noexcept {
+  auto v = __probe_entry(stats_op::next, 0);
   ++pos;  // excludes previous result
   size_t ans = 0;
-  __next(pos + 1, 1, N, 1, ans);
-  return ans ? (ans - 1) : N;
+  __next<1, N, 1>(pos + 1, ans);
+  ans = ans ? (ans - 1) : N;
+  __probe_return(stats_op::next, ans, v);
+  return ans;
 }
 
-template <size_t N>
-constexpr void segbitset<N>::__foreach1(callback& cb, size_t l, size_t r, size_t x) const noexcept {
-  if (!tree[x]) return;
-  if (l == r) {
-    cb(l - 1);
-    return;
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr size_t segbitset<N, Storage, Stats, Summary>::__prev(size_t pos) const noexcept {
+  // Returns the (1-based) position of the last true bit in [1, pos], 0 if not found.
+  // Descends to leaf pos recording the path, then climbs back to the nearest left sibling having
+  // true bits, and descends it to its rightmost true bit.
+  struct {
+    size_t l, r, x;
+  } path[__depth];
+  size_t d = 0, l = 1, r = N, x = 1;
+  while (true) {
+    __stat_visit<stats_op::next>(l, r, __step::descend);
+    path[d++] = {l, r, x};
+    if (!tree[x]) break;  // nothing below
+    if (l == r) return l;
+    auto m = (l + r) >> 1;
+    if (pos <= m) {
+      r = m, x = __ls(x);
+    } else {
+      l = m + 1, x = __rs(x);
+    }
   }
-  auto m = (l + r) >> 1;
-  auto lx = __ls(x), rx = __rs(x);
-  if (tree[lx]) __foreach1(cb, l, m, lx);
-  if (tree[rx]) __foreach1(cb, m + 1, r, rx);
+  for (--d; d > 0; --d) {
+    x = path[d].x;
+    if (!(x & 1) || !tree[x - 1]) continue;  // not a right child, or empty left sibling
+    l = path[d - 1].l, r = path[d].l - 1, x = x - 1;
+    while (l != r) {
+      __stat_visit<stats_op::next>(l, r, __step::descend);
+      auto m = (l + r) >> 1;
+      if (tree[__rs(x)]) {
+        l = m + 1, x = __rs(x);
+      } else {
+        r = m, x = __ls(x);
+      }
+    }
+    __stat_visit<stats_op::next>(l, r, __step::descend);
+    return l;
+  }
+  return 0;
+}
+
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr size_t segbitset<N, Storage, Stats, Summary>::last() const noexcept {
+  return prev(N);
+}
+
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr size_t segbitset<N, Storage, Stats, Summary>::prev(size_t pos) const noexcept {
+  auto v = __probe_entry(stats_op::next, 0);
+  auto ans = pos ? __prev(pos < N ? pos : N) : 0;  // last in [1, pos], aka [0, pos) counting from 0
+  ans = ans ? (ans - 1) : N;
+  __probe_return(stats_op::next, ans, v);
+  return ans;
 }
 
-template <size_t N>
-constexpr void segbitset<N>::foreach1(callback& cb) const noexcept {
-   __foreach1(cb, 1, N, 1);
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr size_t segbitset<N, Storage, Stats, Summary>::pop_first() noexcept {
+  auto pos = first();
+  if (pos < N) reset(pos);
+  return pos;
+}
+
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+template <typename Callback>
+constexpr void segbitset<N, Storage, Stats, Summary>::__foreach1(Callback& cb, size_t l, size_t r,
+                                                                 size_t x) const noexcept {
+  __walk<stats_op::foreach1>(l, r, x, [&](size_t l, size_t r, size_t x) {
+    if (!tree[x]) return __step::prune;
+    if (l == r) cb(l - 1);
+    return __step::descend;
+  });
+}
+
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+template <size_t L, size_t R, size_t X, typename Callback, size_t D>
+constexpr void segbitset<N, Storage, Stats, Summary>::__foreach1(Callback& cb) const noexcept {
+  if constexpr (L == R || D == 0) {
+    __foreach1(cb, L, R, X);
+  } else {
+    if (!tree[X]) {
+      __stat_visit<stats_op::foreach1>(L, R, __step::prune);
+      return;
+    }
+    __stat_visit<stats_op::foreach1>(L, R, __step::descend);
+    constexpr size_t M = (L + R) >> 1;
+    if (tree[__ls(X)]) __foreach1<L, M, __ls(X), Callback, D - 1>(cb);
+    if (tree[__rs(X)]) __foreach1<M + 1, R, __rs(X), Callback, D - 1>(cb);
+  }
+}
+
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+template <typename Callback>
+constexpr void segbitset<N, Storage, Stats, Summary>::foreach1(Callback&& cb) const noexcept {
+  auto v = __probe_entry(stats_op::foreach1, 0);
+  __foreach1<1, N, 1>(cb);
+  __probe_return(stats_op::foreach1, 0, v);
+}
+
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+template <typename Callback>
+constexpr void segbitset<N, Storage, Stats, Summary>::foreach1(size_t first, size_t last,
+                                                               Callback&& cb) const {
+  if (last > N || first > last) throw std::out_of_range("segbitset::foreach1 invalid range");
+  auto v = __probe_entry(stats_op::foreach1, 0);
+  // positions [first, last) are the 1-based interval [first + 1, last].
+  __walk<stats_op::foreach1>(1, N, 1, [&](size_t l, size_t r, size_t x) {
+    if (!tree[x] || r <= first || l > last) return __step::prune;
+    if (l == r) cb(l - 1);
+    return __step::descend;
+  });
+  __probe_return(stats_op::foreach1, 0, v);
+}
+
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr std::pair<size_t, size_t> segbitset<N, Storage, Stats, Summary>::subtree_range(size_t depth,
+                                                                                          size_t i) noexcept {
+  size_t l = 1, r = N;
+  for (auto d = depth; d-- > 0;) {
+    bool right = (i >> d) & 1;
+    if (l == r) {
+      // a leaf above the depth, covered by its leftmost descendant only.
+      if (right) return {r, r};
+      continue;
+    }
+    auto m = (l + r) >> 1;
+    if (right)
+      l = m + 1;
+    else
+      r = m;
+  }
+  return {l - 1, r};
 }
 
 ////////////////////////////////////////
 /// reference
 ////////////////////////////////////////
 
-template <size_t N>
-constexpr typename segbitset<N>::reference segbitset<N>::operator[](size_t pos) {
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr typename segbitset<N, Storage, Stats, Summary>::reference
+segbitset<N, Storage, Stats, Summary>::operator[](size_t pos) {
   if (pos >= N) throw std::out_of_range("segbitset::operator[] pos >= N");
-  auto x = __find(pos + 1, 1, N, 1);
-  return segbitset<N>::reference(*this, x);
+  auto x = __find<1, N, 1>(pos + 1);
+  return reference(*this, x);
 }
 
-template <size_t N>
-constexpr typename segbitset<N>::reference& segbitset<N>::reference::operator=(bool value) noexcept {
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr typename segbitset<N, Storage, Stats, Summary>::reference&
+segbitset<N, Storage, Stats, Summary>::reference::operator=(bool value) noexcept {
   s.tree[x] = value;
+  s.__leaf(x);
   s.__pushup_to_root(x >> 1);
   return *this;
 }
 
-template <size_t N>
-constexpr typename segbitset<N>::reference& segbitset<N>::reference::operator=(
-    const segbitset<N>::reference& reference) noexcept {
-  s.tree[x] = reference.s.tree[x];
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr typename segbitset<N, Storage, Stats, Summary>::reference&
+segbitset<N, Storage, Stats, Summary>::reference::operator=(const reference& reference) noexcept {
+  s.tree[x] = bool(reference);
+  s.__leaf(x);
   s.__pushup_to_root(x >> 1);
   return *this;
 }
 
-template <size_t N>
-constexpr bool segbitset<N>::reference::operator~() const noexcept {
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr bool segbitset<N, Storage, Stats, Summary>::reference::operator~() const noexcept {
   auto b = s.tree[x] = !s.tree[x];
+  s.__leaf(x);
   s.__pushup_to_root(x >> 1);
   return b;
 }
 
-template <size_t N>
-constexpr segbitset<N>::reference::operator bool() const noexcept {
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr segbitset<N, Storage, Stats, Summary>::reference::operator bool() const noexcept {
   return s.tree[x];
 }
 
-template <size_t N>
-constexpr typename segbitset<N>::reference& segbitset<N>::reference::flip() noexcept {
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr typename segbitset<N, Storage, Stats, Summary>::reference&
+segbitset<N, Storage, Stats, Summary>::reference::flip() noexcept {
   s.tree[x] = !s.tree[x];
+  s.__leaf(x);
+  s.__pushup_to_root(x >> 1);
   return *this;
 }
 
@@ -528,22 +1545,28 @@ constexpr typename segbitset<N>::reference& segbitset<N>::reference::flip() noex
 /// Non member operators
 ////////////////////////////////////////
 
-template <size_t N>
-constexpr segbitset<N> operator&(const segbitset<N>& lhs, const segbitset<N>& rhs) noexcept {
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr segbitset<N, Storage, Stats, Summary> operator&(
+    const segbitset<N, Storage, Stats, Summary>& lhs,
+    const segbitset<N, Storage, Stats, Summary>& rhs) noexcept {
   auto s = lhs;
   s &= rhs;
   return s;
 }
 
-template <size_t N>
-constexpr segbitset<N> operator|(const segbitset<N>& lhs, const segbitset<N>& rhs) noexcept {
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr segbitset<N, Storage, Stats, Summary> operator|(
+    const segbitset<N, Storage, Stats, Summary>& lhs,
+    const segbitset<N, Storage, Stats, Summary>& rhs) noexcept {
   auto s = lhs;
   s |= rhs;
   return s;
 }
 
-template <size_t N>
-constexpr segbitset<N> operator^(const segbitset<N>& lhs, const segbitset<N>& rhs) noexcept {
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+constexpr segbitset<N, Storage, Stats, Summary> operator^(
+    const segbitset<N, Storage, Stats, Summary>& lhs,
+    const segbitset<N, Storage, Stats, Summary>& rhs) noexcept {
   auto s = lhs;
   s ^= rhs;
   return s;
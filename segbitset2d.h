@@ -0,0 +1,228 @@
+// Copyright (c) 2024 Chao Wang <hit9@icloud.com>.
+// License: BSD. https://github.com/hit9/segbitset
+// A 2D segbitset of W x H cells, for grid occupancy queries on rectangles.
+//
+// Cells are stored in 8x8 tiles of 64-bit words, row-major inside a tile, and tiles are laid out in Morton
+// (Z) order under a quadtree of counts: node n has children 4n+1..4n+4 (quadrants top-left, top-right,
+// bottom-left, bottom-right), and its count is the number of set cells below it. A zero count prunes the
+// subtree like the OR summary of segbitset, and a node inside the queried rectangle answers by its count,
+// so any(rect) and count(rect) visit only the O(perimeter) nodes on the border of the rectangle, and
+// foreach1(rect) visits only the tiles having set cells. Leaves count by popcount of their tiles, so the
+// counts of inner nodes cost about 11 bits per tile of 64 cells.
+//
+// The quadtree covers the smallest square of 2^k tiles containing the grid, so it fits roughly square grids.
+//
+// Usage:
+//   auto grid = std::make_unique<segbitset::segbitset2d<4096, 4096>>();
+//   grid->set(10, 20);
+//   grid->any({0, 0, 64, 64});                              // rectangle [0, 64) x [0, 64)
+//   grid->foreach1({0, 0, 64, 64}, [](size_t x, size_t y) { ... });
+
+#ifndef __HIT9_SEGBITSET2D
+#define __HIT9_SEGBITSET2D
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+
+namespace segbitset {
+
+using size_t = std::size_t;
+
+// rect is the rectangle of cells [x0, x1) x [y0, y1).
+struct rect {
+  size_t x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+  constexpr bool empty() const noexcept { return x0 >= x1 || y0 >= y1; }
+};
+
+template <size_t W, size_t H>
+class segbitset2d {
+  static_assert(W > 0 && H > 0);
+  static constexpr size_t TILE = 8;                                               // side of a tile
+  static constexpr size_t S = std::bit_ceil((std::max(W, H) + TILE - 1) / TILE);  // tiles per side
+  static constexpr size_t T = S * S;                                              // number of tiles
+  static constexpr size_t I = (T - 1) / 3;  // number of inner nodes, the leaf of tile m is I + m
+  static constexpr size_t D = std::countr_zero(S);  // depth of leaves
+  using count_t = std::conditional_t<(W * H < (size_t(1) << 32)), uint32_t, uint64_t>;
+
+ public:
+  constexpr segbitset2d() noexcept = default;
+
+  // returns the width, that is W.
+  constexpr size_t width() const noexcept { return W; }
+  // returns the height, that is H.
+  constexpr size_t height() const noexcept { return H; }
+
+  // returns the value of the cell (x, y).
+  // throws std::out_of_range if the cell is invalid.
+  constexpr bool test(size_t x, size_t y) const;
+  // sets the cell (x, y) to the given value.
+  // throws std::out_of_range if the cell is invalid.
+  constexpr segbitset2d& set(size_t x, size_t y, bool value = true);
+  // sets the cell (x, y) to false.
+  // throws std::out_of_range if the cell is invalid.
+  constexpr segbitset2d& reset(size_t x, size_t y) { return set(x, y, false); }
+  // sets all cells to false, walking only the tiles having set cells.
+  constexpr segbitset2d& reset() noexcept;
+
+  // checks if any cell is set, O(1).
+  constexpr bool any() const noexcept { return __count(0); }
+  // checks if no cell is set, O(1).
+  constexpr bool none() const noexcept { return !any(); }
+  // returns the number of set cells, O(1).
+  constexpr size_t count() const noexcept { return __count(0); }
+  // checks if any cell in the rectangle r is set, the part of r out of the grid is ignored.
+  constexpr bool any(const rect& r) const noexcept;
+  // returns the number of set cells in the rectangle r, the part of r out of the grid is ignored.
+  constexpr size_t count(const rect& r) const noexcept;
+  // iterates the set cells in the rectangle r in Z-order, calling cb(x, y) for each.
+  template <typename Callback>
+  constexpr void foreach1(const rect& r, Callback&& cb) const;
+  // iterates all set cells in Z-order, calling cb(x, y) for each.
+  template <typename Callback>
+  constexpr void foreach1(Callback&& cb) const {
+    foreach1(rect{0, 0, W, H}, cb);
+  }
+
+ private:
+  // steps of a walk after visiting a node.
+  enum class __step { stop, prune, descend };
+
+  uint64_t tiles[T]{};          // cells of each tile, bit 8*y+x for the cell (x, y) in the tile
+  count_t counts[I ? I : 1]{};  // number of set cells below each inner node
+
+  // returns the Morton index of tile (tx, ty), interleaving the bits of tx (even) and ty (odd).
+  static constexpr size_t __morton(size_t tx, size_t ty) noexcept;
+  // returns the mask of the cells of tile (tx, ty) in the rectangle r.
+  static constexpr uint64_t __mask(const rect& r, size_t tx, size_t ty) noexcept;
+  // returns the number of set cells below node n.
+  constexpr size_t __count(size_t n) const noexcept {
+    return n < I ? size_t(counts[n]) : size_t(std::popcount(tiles[n - I]));
+  }
+  // walks the nodes having set cells and intersecting r in Z-order, calling visit(n, tx, ty, inside) on
+  // each, where (tx, ty) is the first tile of the node, and inside tells whether the node is inside r. The
+  // walk won't descend leaves. Returns false if stopped by visit.
+  template <typename Visit>
+  constexpr bool __walk(const rect& r, Visit&& visit) const;
+};
+
+template <size_t W, size_t H>
+constexpr size_t segbitset2d<W, H>::__morton(size_t tx, size_t ty) noexcept {
+  size_t m = 0;
+  for (size_t i = 0; i < D; i++) m |= (((tx >> i) & 1) << (i << 1)) | (((ty >> i) & 1) << ((i << 1) | 1));
+  return m;
+}
+
+template <size_t W, size_t H>
+constexpr uint64_t segbitset2d<W, H>::__mask(const rect& r, size_t tx, size_t ty) noexcept {
+  auto clamp = [](size_t v, size_t base) { return v <= base ? 0 : std::min(v - base, TILE); };
+  auto x0 = clamp(r.x0, tx * TILE), x1 = clamp(r.x1, tx * TILE);
+  auto y0 = clamp(r.y0, ty * TILE), y1 = clamp(r.y1, ty * TILE);
+  uint64_t columns = ((uint64_t(1) << x1) - 1) & ~((uint64_t(1) << x0) - 1);
+  uint64_t rows = (y1 == TILE ? ~uint64_t(0) : (uint64_t(1) << (y1 * TILE)) - 1) &
+                  ~((uint64_t(1) << (y0 * TILE)) - 1);
+  return (columns * 0x0101010101010101) & rows;  // columns repeated on each row
+}
+
+template <size_t W, size_t H>
+template <typename Visit>
+constexpr bool segbitset2d<W, H>::__walk(const rect& r, Visit&& visit) const {
+  struct {
+    size_t n, tx, ty, side;  // node, its first tile, and its side in tiles
+  } stack[3 * D + 1];        // pending siblings
+  size_t top = 0;
+  stack[top++] = {0, 0, 0, S};
+  while (top) {
+    auto [n, tx, ty, side] = stack[--top];
+    if (!__count(n)) continue;  // no set cells below
+    auto x0 = tx * TILE, y0 = ty * TILE, x1 = (tx + side) * TILE, y1 = (ty + side) * TILE;
+    if (x1 <= r.x0 || r.x1 <= x0 || y1 <= r.y0 || r.y1 <= y0) continue;  // disjoint
+    bool inside = r.x0 <= x0 && x1 <= r.x1 && r.y0 <= y0 && y1 <= r.y1;
+    auto step = visit(n, tx, ty, inside);
+    if (step == __step::stop) return false;
+    if (step == __step::prune || n >= I) continue;
+    // pushes the quadrants in reverse, so they are popped in Z-order.
+    auto half = side >> 1;
+    for (size_t q = 4; q-- > 0;)
+      stack[top++] = {(n << 2) + 1 + q, tx + (q & 1) * half, ty + (q >> 1) * half, half};
+  }
+  return true;
+}
+
+template <size_t W, size_t H>
+constexpr bool segbitset2d<W, H>::test(size_t x, size_t y) const {
+  if (x >= W || y >= H) throw std::out_of_range("segbitset2d::test cell out of grid");
+  return (tiles[__morton(x / TILE, y / TILE)] >> ((y % TILE) * TILE + x % TILE)) & 1;
+}
+
+template <size_t W, size_t H>
+constexpr segbitset2d<W, H>& segbitset2d<W, H>::set(size_t x, size_t y, bool value) {
+  if (x >= W || y >= H) throw std::out_of_range("segbitset2d::set cell out of grid");
+  auto m = __morton(x / TILE, y / TILE);
+  auto bit = uint64_t(1) << ((y % TILE) * TILE + x % TILE);
+  if (bool(tiles[m] & bit) == value) return *this;
+  tiles[m] ^= bit;
+  for (auto n = I + m; n;) {  // updates the counts from the parent of the leaf to the root
+    n = (n - 1) >> 2;
+    counts[n] += value ? count_t(1) : count_t(-1);
+  }
+  return *this;
+}
+
+template <size_t W, size_t H>
+constexpr segbitset2d<W, H>& segbitset2d<W, H>::reset() noexcept {
+  __walk(rect{0, 0, W, H}, [&](size_t n, size_t, size_t, bool) {
+    if (n >= I)
+      tiles[n - I] = 0;
+    else
+      counts[n] = 0;  // read by the walk only before it's visited, so cleared on the way down.
+    return __step::descend;
+  });
+  return *this;
+}
+
+template <size_t W, size_t H>
+constexpr bool segbitset2d<W, H>::any(const rect& r) const noexcept {
+  if (r.empty()) return false;
+  return !__walk(r, [&](size_t n, size_t tx, size_t ty, bool inside) {
+    if (inside) return __step::stop;  // a node having set cells inside r
+    if (n >= I && (tiles[n - I] & __mask(r, tx, ty))) return __step::stop;
+    return __step::descend;
+  });
+}
+
+template <size_t W, size_t H>
+constexpr size_t segbitset2d<W, H>::count(const rect& r) const noexcept {
+  size_t ans = 0;
+  if (r.empty()) return ans;
+  __walk(r, [&](size_t n, size_t tx, size_t ty, bool inside) {
+    if (inside) {
+      ans += __count(n);
+      return __step::prune;
+    }
+    if (n >= I) ans += std::popcount(tiles[n - I] & __mask(r, tx, ty));
+    return __step::descend;
+  });
+  return ans;
+}
+
+template <size_t W, size_t H>
+template <typename Callback>
+constexpr void segbitset2d<W, H>::foreach1(const rect& r, Callback&& cb) const {
+  if (r.empty()) return;
+  __walk(r, [&](size_t n, size_t tx, size_t ty, bool inside) {
+    if (n < I) return __step::descend;
+    for (auto m = tiles[n - I] & (inside ? ~uint64_t(0) : __mask(r, tx, ty)); m; m &= m - 1) {
+      auto bit = size_t(std::countr_zero(m));
+      cb(tx * TILE + bit % TILE, ty * TILE + bit / TILE);
+    }
+    return __step::prune;
+  });
+}
+
+}  // namespace segbitset
+
+#endif
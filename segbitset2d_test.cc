@@ -0,0 +1,78 @@
+#include "segbitset2d.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+static std::mt19937 rng(std::random_device{}());
+
+TEST_CASE("segbitset2d", "[rectangle queries - compare to brute force]") {
+  const std::size_t W = 100, H = 70;
+  auto grid = std::make_unique<segbitset::segbitset2d<W, H>>();
+  std::vector<std::vector<bool>> e(W, std::vector<bool>(H));
+  std::uniform_int_distribution<std::size_t> xs(0, W - 1), ys(0, H - 1), sides(0, 40);
+  auto check = [&](const segbitset::rect& r) {
+    std::size_t n = 0;
+    std::vector<std::pair<std::size_t, std::size_t>> cells;
+    for (std::size_t x = r.x0; x < std::min(r.x1, W); x++)
+      for (std::size_t y = r.y0; y < std::min(r.y1, H); y++)
+        if (e[x][y]) n++;
+    REQUIRE(grid->count(r) == n);
+    REQUIRE(grid->any(r) == (n > 0));
+    grid->foreach1(r, [&](std::size_t x, std::size_t y) {
+      REQUIRE(e[x][y]);
+      REQUIRE((r.x0 <= x && x < r.x1 && r.y0 <= y && y < r.y1));
+      cells.emplace_back(x, y);
+    });
+    REQUIRE(cells.size() == n);
+  };
+  REQUIRE(grid->none());
+  for (int i = 0; i < 3000; i++) {
+    auto x = xs(rng), y = ys(rng);
+    // clusters in the top-left corner, so that most tiles are empty.
+    if (i % 3) x %= 20, y %= 20;
+    bool value = i % 4;
+    grid->set(x, y, value);
+    e[x][y] = value;
+    REQUIRE(grid->test(x, y) == value);
+    if (i % 100 == 0) {
+      auto x0 = xs(rng), y0 = ys(rng);
+      check({x0, y0, x0 + sides(rng), y0 + sides(rng)});
+    }
+  }
+  check({0, 0, W, H});
+  check({0, 0, 1000, 1000});
+  check({5, 5, 5, 50});
+  check({64, 0, 100, 8});
+  std::size_t total = 0;
+  for (auto& column : e)
+    for (bool cell : column) total += cell;
+  REQUIRE(grid->count() == total);
+  grid->reset();
+  REQUIRE(grid->none());
+  REQUIRE(grid->count({0, 0, W, H}) == 0);
+  REQUIRE(!grid->test(3, 3));
+  REQUIRE_THROWS_AS(grid->set(W, 0), std::out_of_range);
+  REQUIRE_THROWS_AS(grid->test(0, H), std::out_of_range);
+}
+
+TEST_CASE("segbitset2d", "[Z-order and constexpr]") {
+  static constexpr auto grid = [] {
+    segbitset::segbitset2d<16, 16> grid;
+    grid.set(9, 1).set(1, 9).set(2, 2).set(15, 15);
+    return grid;
+  }();
+  static_assert(grid.count() == 4);
+  static_assert(grid.count({0, 0, 8, 8}) == 1);
+  static_assert(grid.any({8, 0, 16, 8}) && !grid.any({3, 3, 16, 8}));
+  std::vector<std::pair<std::size_t, std::size_t>> cells;
+  grid.foreach1([&](std::size_t x, std::size_t y) { cells.emplace_back(x, y); });
+  REQUIRE(cells == std::vector<std::pair<std::size_t, std::size_t>>{{2, 2}, {9, 1}, {1, 9}, {15, 15}});
+  segbitset::segbitset2d<5, 3> tiny;  // a single tile
+  tiny.set(4, 2);
+  REQUIRE(tiny.count({4, 2, 5, 3}) == 1);
+  REQUIRE(!tiny.any({0, 0, 4, 3}));
+}
@@ -0,0 +1,242 @@
+// Copyright (c) 2024 Chao Wang <hit9@icloud.com>.
+// License: BSD. https://github.com/hit9/segbitset
+// A direction-optimizing BFS on segbitsets, for graphs whose frontier swings from a few vertices to most.
+//
+// The frontier and the unvisited vertices are segbitsets of N vertices, over an undirected graph in CSR form
+// (the neighbors of u are targets[offsets[u] .. offsets[u+1]), each edge stored in both directions).
+// Both are mirrored in flat bitmaps of 64-bit words, so checking the endpoint of an edge is O(1) instead of
+// a walk from the root. Each step expands the frontier by one level, in one of two directions:
+//
+//   top-down:  for each vertex of the frontier, by foreach1 which skips empty subtrees, claims its unvisited
+//              neighbors in the flat bitmap. Costs the edges of the frontier.
+//   bottom-up: for each unvisited vertex, by foreach1 on the unvisited set which shrinks as the search goes,
+//              checks if any neighbor is on the frontier, stopping at the first. Costs the edges of the
+//              unvisited vertices, but most stop early once the frontier is large.
+//
+// Directions are switched as Beamer et al. do: to bottom-up once the edges of the frontier exceed those
+// of the unvisited vertices divided by alpha, and back to top-down once the frontier has less than N/beta
+// vertices. With threads > 1, the tree is split at the subtree roots at depth ceil(log2(threads)), each
+// thread walking only its own subtrees, and collecting what it found into a segbitset of its own, which are
+// then merged by bulk |= and andnot.
+//
+// Usage:
+//   auto bfs = std::make_unique<segbitset::bfs_frontier<N>>(offsets, targets);
+//   bfs->start(source);  // distance[source] = 0
+//   while (bfs->step()) bfs->frontier().foreach1([&](size_t v) { distance[v] = bfs->level(); });
+
+#ifndef __HIT9_SEGBITSET_BFS
+#define __HIT9_SEGBITSET_BFS
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "segbitset.h"
+
+namespace segbitset {
+
+// bfs_options tunes the direction switching and the parallelism of bfs_frontier.
+struct bfs_options {
+  double alpha = 14;     // switches to bottom-up once frontier edges > unvisited edges / alpha
+  double beta = 24;      // switches back to top-down once frontier vertices < N / beta
+  unsigned threads = 1;  // number of threads expanding a level, 1 to expand on the calling thread only
+};
+
+template <size_t N, template <size_t> class Storage = word_bitset>
+class bfs_frontier {
+  static_assert(N <= (size_t(1) << 32), "vertices are 32-bit");
+
+ public:
+  using bitset_type = segbitset<N, Storage>;
+
+  // creates a BFS over the undirected graph in CSR form, offsets has N+1 entries. The graph is referenced,
+  // not copied. throws std::invalid_argument if offsets has not N+1 entries.
+  bfs_frontier(std::span<const size_t> offsets, std::span<const uint32_t> targets, bfs_options options = {});
+
+  // starts a search from source, the frontier is {source} on level 0.
+  // throws std::out_of_range if source is invalid.
+  void start(size_t source);
+  // expands the frontier by one level, returns false if the new frontier is empty, the search is done.
+  bool step();
+
+  // returns the vertices on the current level.
+  const bitset_type& frontier() const noexcept { return *__frontier; }
+  // returns the vertices not visited yet.
+  const bitset_type& unvisited() const noexcept { return *__unvisited; }
+  // returns the level of the frontier, 0 for the source.
+  size_t level() const noexcept { return __level; }
+  // returns true if the last step expanded bottom-up.
+  bool bottom_up() const noexcept { return __bottom_up; }
+
+ private:
+  static constexpr size_t W = (N + 63) >> 6;  // words of a flat bitmap
+
+  // what a thread found in a step.
+  struct __found_type {
+    std::unique_ptr<bitset_type> vertices = std::make_unique<bitset_type>();
+    size_t size = 0;   // number of vertices
+    size_t edges = 0;  // edges of the vertices
+  };
+
+  std::span<const size_t> offsets;
+  std::span<const uint32_t> targets;
+  bfs_options options;
+  size_t __depth;  // subtrees of a step are split at this depth
+  std::unique_ptr<bitset_type> __frontier = std::make_unique<bitset_type>();
+  std::unique_ptr<bitset_type> __next = std::make_unique<bitset_type>();
+  std::unique_ptr<bitset_type> __unvisited = std::make_unique<bitset_type>();
+  std::vector<uint64_t> __frontier_words = std::vector<uint64_t>(W);    // flat bitmap of the frontier
+  std::vector<uint64_t> __unvisited_words = std::vector<uint64_t>(W);  // flat bitmap of the unvisited
+  std::vector<__found_type> __found;                                     // by each thread
+  size_t __level = 0;
+  bool __bottom_up = false;
+  size_t __frontier_size = 0;   // vertices of the frontier
+  size_t __frontier_edges = 0;  // edges of the frontier
+  size_t __unvisited_edges = 0;
+
+  size_t __degree(size_t u) const noexcept { return offsets[u + 1] - offsets[u]; }
+  static bool __test(const std::vector<uint64_t>& words, size_t v) noexcept {
+    return (words[v >> 6] >> (v & 63)) & 1;
+  }
+  // clears v in the flat bitmap of the unvisited, returns true if this call did, atomically if on threads.
+  bool __claim(size_t v) noexcept;
+  // calls cb(pos) for each true bit of s in positions [first, last), skipping empty subtrees.
+  template <typename Callback>
+  static void __foreach1(const bitset_type& s, size_t first, size_t last, Callback&& cb) {
+    if (first == 0 && last == N)
+      s.foreach1(cb);  // unrolls the top levels
+    else if (first < last)
+      s.foreach1(first, last, cb);
+  }
+  // expands the vertices in [first, last) into found.
+  void __top_down(size_t first, size_t last, __found_type& found);
+  void __bottom_up_scan(size_t first, size_t last, __found_type& found);
+};
+
+template <size_t N, template <size_t> class Storage>
+bfs_frontier<N, Storage>::bfs_frontier(std::span<const size_t> offsets, std::span<const uint32_t> targets,
+                                       bfs_options options)
+    : offsets(offsets),
+      targets(targets),
+      options(options),
+      __depth(std::bit_width(std::max(options.threads, 1u) - 1)),
+      __found(std::max(options.threads, 1u)) {
+  if (offsets.size() != N + 1) throw std::invalid_argument("bfs_frontier: offsets must have N+1 entries");
+}
+
+template <size_t N, template <size_t> class Storage>
+void bfs_frontier<N, Storage>::start(size_t source) {
+  if (source >= N) throw std::out_of_range("bfs_frontier::start source >= N");
+  __frontier->reset();
+  __unvisited->set();
+  __unvisited->reset(source);
+  __frontier->set(source);
+  std::fill(__frontier_words.begin(), __frontier_words.end(), 0);
+  std::fill(__unvisited_words.begin(), __unvisited_words.end(), ~uint64_t(0));
+  if (N & 63) __unvisited_words[W - 1] = (uint64_t(1) << (N & 63)) - 1;
+  __frontier_words[source >> 6] |= uint64_t(1) << (source & 63);
+  __unvisited_words[source >> 6] &= ~(uint64_t(1) << (source & 63));
+  __level = 0;
+  __bottom_up = false;
+  __frontier_size = 1;
+  __frontier_edges = __degree(source);
+  __unvisited_edges = offsets[N] - offsets[0] - __frontier_edges;
+}
+
+template <size_t N, template <size_t> class Storage>
+bool bfs_frontier<N, Storage>::__claim(size_t v) noexcept {
+  auto& word = __unvisited_words[v >> 6];
+  auto bit = uint64_t(1) << (v & 63);
+  if (__found.size() == 1) {
+    if (!(word & bit)) return false;
+    word &= ~bit;
+    return true;
+  }
+  // subtrees of threads may share a word at their boundaries, and top-down threads race on neighbors.
+  std::atomic_ref<uint64_t> w(word);
+  return (w.load(std::memory_order_relaxed) & bit) && (w.fetch_and(~bit, std::memory_order_relaxed) & bit);
+}
+
+template <size_t N, template <size_t> class Storage>
+void bfs_frontier<N, Storage>::__top_down(size_t first, size_t last, __found_type& found) {
+  __foreach1(*__frontier, first, last, [&](size_t u) {
+    for (auto i = offsets[u]; i < offsets[u + 1]; i++) {
+      auto v = targets[i];
+      if (!__claim(v)) continue;  // visited, or claimed by another thread
+      found.vertices->set(v);
+      found.size++, found.edges += __degree(v);
+    }
+  });
+}
+
+template <size_t N, template <size_t> class Storage>
+void bfs_frontier<N, Storage>::__bottom_up_scan(size_t first, size_t last, __found_type& found) {
+  __foreach1(*__unvisited, first, last, [&](size_t v) {
+    for (auto i = offsets[v]; i < offsets[v + 1]; i++) {
+      if (__test(__frontier_words, targets[i])) {
+        __claim(v);  // v is in the subtrees of this thread only
+        found.vertices->set(v);
+        found.size++, found.edges += __degree(v);
+        break;
+      }
+    }
+  });
+}
+
+template <size_t N, template <size_t> class Storage>
+bool bfs_frontier<N, Storage>::step() {
+  if (!__frontier_size) return false;
+  if (!__bottom_up && __frontier_edges > __unvisited_edges / options.alpha)
+    __bottom_up = true;
+  else if (__bottom_up && __frontier_size < N / options.beta)
+    __bottom_up = false;
+
+  // expands the subtrees at __depth, thread i taking subtrees i, i + threads, ...
+  auto threads = __found.size();
+  auto expand = [&](size_t i) {
+    for (auto j = i; j < (size_t(1) << __depth); j += threads) {
+      auto [first, last] = bitset_type::subtree_range(__depth, j);
+      if (__bottom_up)
+        __bottom_up_scan(first, last, __found[i]);
+      else
+        __top_down(first, last, __found[i]);
+    }
+  };
+  if (threads == 1) {
+    expand(0);
+  } else {
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < threads; i++) workers.emplace_back(expand, i);
+    expand(0);
+    for (auto& t : workers) t.join();
+  }
+
+  // merges what's found into the next frontier, by bulk operations walking only the found vertices.
+  __next->reset();
+  __frontier_size = __frontier_edges = 0;
+  for (auto& found : __found) {
+    *__next |= *found.vertices;
+    found.vertices->reset();
+    __frontier_size += found.size, __frontier_edges += found.edges;
+    found.size = found.edges = 0;
+  }
+  __unvisited->andnot(*__next);
+  __unvisited_edges -= __frontier_edges;
+  __frontier->foreach1([&](size_t v) { __frontier_words[v >> 6] &= ~(uint64_t(1) << (v & 63)); });
+  __next->foreach1([&](size_t v) { __frontier_words[v >> 6] |= uint64_t(1) << (v & 63); });
+  std::swap(__frontier, __next);
+  __level++;
+  return __frontier_size;
+}
+
+}  // namespace segbitset
+
+#endif
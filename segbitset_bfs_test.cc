@@ -0,0 +1,78 @@
+#include "segbitset_bfs.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <cstdint>
+#include <memory>
+#include <queue>
+#include <random>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+static std::mt19937 rng(std::random_device{}());
+
+TEST_CASE("bfs_frontier", "[distances - compare to queue based bfs]") {
+  const std::size_t N = 3000;
+  // a sparse random graph, plus a dense cluster to make the frontier swing.
+  std::uniform_int_distribution<std::size_t> distribution(0, N - 1);
+  std::vector<std::vector<uint32_t>> adjacency(N);
+  auto add = [&](std::size_t u, std::size_t v) {
+    adjacency[u].push_back(v);
+    adjacency[v].push_back(u);
+  };
+  for (std::size_t i = 0; i < N; i++) add(distribution(rng), distribution(rng));
+  for (std::size_t i = 0; i < 20000; i++) add(distribution(rng) % 300, distribution(rng) % 300);
+  std::vector<std::size_t> offsets{0};
+  std::vector<uint32_t> targets;
+  for (auto& neighbors : adjacency) {
+    targets.insert(targets.end(), neighbors.begin(), neighbors.end());
+    offsets.push_back(targets.size());
+  }
+
+  auto source = distribution(rng) % 300;
+  std::vector<std::size_t> expected(N, N);
+  std::queue<std::size_t> q;
+  expected[source] = 0, q.push(source);
+  while (!q.empty()) {
+    auto u = q.front();
+    q.pop();
+    for (auto v : adjacency[u])
+      if (expected[v] == N) expected[v] = expected[u] + 1, q.push(v);
+  }
+
+  // adaptive, always top-down, always bottom-up, on 1, 3 and 8 threads.
+  for (auto [alpha, beta] : {std::pair{14.0, 24.0}, std::pair{0.0, 24.0}, std::pair{1e18, 1e18}}) {
+    for (unsigned threads : {1, 3, 8}) {
+      segbitset::bfs_options options{alpha, beta, threads};
+      auto bfs = std::make_unique<segbitset::bfs_frontier<N>>(offsets, targets, options);
+      std::vector<std::size_t> distance(N, N);
+      bfs->start(source);
+      distance[source] = 0;
+      bool bottom_up = false;
+      while (bfs->step()) {
+        bottom_up = bottom_up || bfs->bottom_up();
+        bfs->frontier().foreach1([&](std::size_t v) {
+          REQUIRE(distance[v] == N);
+          distance[v] = bfs->level();
+        });
+      }
+      REQUIRE(distance == expected);
+      REQUIRE(!bfs->step());
+      if (alpha == 0) REQUIRE(!bottom_up);
+      if (alpha > 1e9) REQUIRE(bottom_up);
+    }
+  }
+}
+
+TEST_CASE("bfs_frontier", "[invalid arguments]") {
+  std::vector<std::size_t> offsets{0, 1, 2};
+  std::vector<uint32_t> targets{1, 0};
+  REQUIRE_THROWS_AS(segbitset::bfs_frontier<3>(offsets, targets), std::invalid_argument);
+  segbitset::bfs_frontier<2> bfs(offsets, targets);
+  REQUIRE_THROWS_AS(bfs.start(2), std::out_of_range);
+  bfs.start(1);
+  REQUIRE(bfs.step());
+  REQUIRE(bfs.frontier().first() == 0);
+  REQUIRE(!bfs.step());
+  REQUIRE(bfs.unvisited().none());
+}
@@ -0,0 +1,220 @@
+// Copyright (c) 2024 Chao Wang <hit9@icloud.com>.
+// License: BSD. https://github.com/hit9/segbitset
+// A bit-sliced index of unsigned integers of Bits bits on N rows, for range predicates as bitmaps.
+//
+// The index is a segbitset of the rows having a value, plus one segbitset per bit of the values: slice i
+// holds the rows whose value has bit i set. Queries combine the slices from the highest bit down, as in
+// O'Neil's algorithms, by &=, andnot, or_andnot and count_and, each walking only the subtrees having true
+// bits in the operands without copying them, so queries on sparse slices and selective predicates touch few
+// nodes:
+//
+//   eq(c), lt(c), le(c), between(lo, hi): the rows still equal to c on the bits so far narrow down slice by
+//     slice, and the comparison stops early once none is left.
+//   sum(): sums the counts of the slices, weighted by their bits.
+//   top_k(k): the rows of the k largest values, narrowing the candidates slice by slice.
+//
+// Usage:
+//   auto index = std::make_unique<segbitset::bit_sliced_index<N, 16>>();
+//   index->set(row, price);
+//   auto cheap = index->lt(100);             // segbitset<N> of the rows with price < 100
+//   auto mid = index->between(100, 200);     // 100 <= price <= 200
+
+#ifndef __HIT9_SEGBITSET_BSI
+#define __HIT9_SEGBITSET_BSI
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+#include "segbitset.h"
+
+namespace segbitset {
+
+template <size_t N, unsigned Bits = 32, template <size_t> class Storage = word_bitset>
+class bit_sliced_index {
+  static_assert(Bits > 0 && Bits <= 64);
+
+ public:
+  using bitset_type = segbitset<N, Storage>;
+  using value_type = uint64_t;
+  // the largest value.
+  static constexpr value_type MAX = Bits == 64 ? ~value_type(0) : (value_type(1) << Bits) - 1;
+
+  bit_sliced_index() = default;
+
+  // returns the number of rows, that is N.
+  constexpr size_t max_size() const noexcept { return N; }
+  // returns the number of rows having a value.
+  size_t size() const noexcept { return exists.count(); }
+  // returns true if row pos has a value, false if pos is out of range.
+  bool contains(size_t pos) const noexcept { return pos < N && exists.test(pos); }
+  // returns the value of row pos.
+  // throws std::out_of_range if row pos has no value.
+  value_type get(size_t pos) const;
+  // sets the value of row pos.
+  // throws std::out_of_range if pos is invalid, std::invalid_argument if value is greater than MAX.
+  bit_sliced_index& set(size_t pos, value_type value);
+  // removes the value of row pos.
+  // throws std::out_of_range if pos is invalid.
+  bit_sliced_index& reset(size_t pos);
+  // removes all values.
+  bit_sliced_index& reset() noexcept;
+
+  // returns the rows having a value.
+  const bitset_type& rows() const noexcept { return exists; }
+  // returns slice i, the rows whose value has bit i set.
+  // throws std::out_of_range if i is not less than Bits.
+  const bitset_type& slice(unsigned i) const {
+    if (i >= Bits) throw std::out_of_range("bit_sliced_index::slice i >= Bits");
+    return slices[i];
+  }
+
+  // returns the rows whose value equals c.
+  bitset_type eq(value_type c) const noexcept;
+  // returns the rows whose value is less than c.
+  bitset_type lt(value_type c) const noexcept;
+  // returns the rows whose value is less than or equal to c.
+  bitset_type le(value_type c) const noexcept;
+  // returns the rows whose value is in [lo, hi], empty if lo > hi.
+  bitset_type between(value_type lo, value_type hi) const noexcept;
+  // returns the sum of all values, modulo 2^64.
+  value_type sum() const noexcept;
+  // returns the sum of the values of the rows in filter, modulo 2^64.
+  value_type sum(const bitset_type& filter) const noexcept;
+  // returns k rows of the largest values, ties broken by the lower rows, all rows if k >= size().
+  bitset_type top_k(size_t k) const noexcept;
+
+ private:
+  bitset_type exists;
+  bitset_type slices[Bits];
+
+  // compares the values to c, leaving in lt the rows less than c (if not null), and in eq the rows equal.
+  void __compare(value_type c, bitset_type* lt, bitset_type& eq) const noexcept;
+};
+
+template <size_t N, unsigned Bits, template <size_t> class Storage>
+typename bit_sliced_index<N, Bits, Storage>::value_type bit_sliced_index<N, Bits, Storage>::get(
+    size_t pos) const {
+  if (!contains(pos)) throw std::out_of_range("bit_sliced_index::get: no value");
+  value_type value = 0;
+  for (unsigned i = 0; i < Bits; i++) value |= value_type(slices[i].test(pos)) << i;
+  return value;
+}
+
+template <size_t N, unsigned Bits, template <size_t> class Storage>
+bit_sliced_index<N, Bits, Storage>& bit_sliced_index<N, Bits, Storage>::set(size_t pos, value_type value) {
+  if (pos >= N) throw std::out_of_range("bit_sliced_index::set pos >= N");
+  if (value > MAX) throw std::invalid_argument("bit_sliced_index::set value > MAX");
+  exists.set(pos);
+  for (unsigned i = 0; i < Bits; i++) slices[i].set(pos, (value >> i) & 1);
+  return *this;
+}
+
+template <size_t N, unsigned Bits, template <size_t> class Storage>
+bit_sliced_index<N, Bits, Storage>& bit_sliced_index<N, Bits, Storage>::reset(size_t pos) {
+  if (pos >= N) throw std::out_of_range("bit_sliced_index::reset pos >= N");
+  exists.reset(pos);
+  for (auto& slice : slices) slice.reset(pos);
+  return *this;
+}
+
+template <size_t N, unsigned Bits, template <size_t> class Storage>
+bit_sliced_index<N, Bits, Storage>& bit_sliced_index<N, Bits, Storage>::reset() noexcept {
+  exists.reset();
+  for (auto& slice : slices) slice.reset();
+  return *this;
+}
+
+template <size_t N, unsigned Bits, template <size_t> class Storage>
+void bit_sliced_index<N, Bits, Storage>::__compare(value_type c, bitset_type* lt,
+                                                   bitset_type& eq) const noexcept {
+  eq = exists;
+  for (unsigned i = Bits; i-- > 0 && eq.any();) {  // stops once no row is equal on the higher bits
+    if ((c >> i) & 1) {
+      // rows equal so far, but having 0 on bit i, are less than c.
+      if (lt) lt->or_andnot(eq, slices[i]);
+      eq &= slices[i];
+    } else {
+      eq.andnot(slices[i]);
+    }
+  }
+}
+
+template <size_t N, unsigned Bits, template <size_t> class Storage>
+typename bit_sliced_index<N, Bits, Storage>::bitset_type bit_sliced_index<N, Bits, Storage>::eq(
+    value_type c) const noexcept {
+  bitset_type eq;
+  if (c <= MAX) __compare(c, nullptr, eq);
+  return eq;
+}
+
+template <size_t N, unsigned Bits, template <size_t> class Storage>
+typename bit_sliced_index<N, Bits, Storage>::bitset_type bit_sliced_index<N, Bits, Storage>::lt(
+    value_type c) const noexcept {
+  if (c > MAX) return exists;
+  bitset_type lt, eq;
+  __compare(c, &lt, eq);
+  return lt;
+}
+
+template <size_t N, unsigned Bits, template <size_t> class Storage>
+typename bit_sliced_index<N, Bits, Storage>::bitset_type bit_sliced_index<N, Bits, Storage>::le(
+    value_type c) const noexcept {
+  if (c >= MAX) return exists;
+  bitset_type lt, eq;
+  __compare(c, &lt, eq);
+  lt |= eq;
+  return lt;
+}
+
+template <size_t N, unsigned Bits, template <size_t> class Storage>
+typename bit_sliced_index<N, Bits, Storage>::bitset_type bit_sliced_index<N, Bits, Storage>::between(
+    value_type lo, value_type hi) const noexcept {
+  if (lo > hi || lo > MAX) return bitset_type();
+  auto ans = le(hi);
+  if (lo) ans.andnot(lt(lo));
+  return ans;
+}
+
+template <size_t N, unsigned Bits, template <size_t> class Storage>
+typename bit_sliced_index<N, Bits, Storage>::value_type bit_sliced_index<N, Bits, Storage>::sum()
+    const noexcept {
+  value_type ans = 0;
+  for (unsigned i = 0; i < Bits; i++) ans += value_type(slices[i].count()) << i;
+  return ans;
+}
+
+template <size_t N, unsigned Bits, template <size_t> class Storage>
+typename bit_sliced_index<N, Bits, Storage>::value_type bit_sliced_index<N, Bits, Storage>::sum(
+    const bitset_type& filter) const noexcept {
+  value_type ans = 0;
+  for (unsigned i = 0; i < Bits; i++) ans += value_type(slices[i].count_and(filter)) << i;
+  return ans;
+}
+
+template <size_t N, unsigned Bits, template <size_t> class Storage>
+typename bit_sliced_index<N, Bits, Storage>::bitset_type bit_sliced_index<N, Bits, Storage>::top_k(
+    size_t k) const noexcept {
+  // g holds the rows surely in the top k, e the candidates equal on the bits so far.
+  bitset_type g, e = exists;
+  size_t n = 0;  // number of rows in g
+  for (unsigned i = Bits; i-- > 0 && e.any();) {
+    auto m = e.count_and(slices[i]);  // candidates having 1 on bit i, greater than the other candidates
+    if (n + m > k) {
+      e &= slices[i];  // too many, narrows down the candidates to them
+    } else if (m) {
+      auto x = e;  // all in, and the rest of the candidates go on
+      x &= slices[i];
+      g |= x, n += m;
+      if (n == k) return g;
+      e.andnot(slices[i]);
+    }
+  }
+  // the candidates left are all equal, takes the lowest rows of them.
+  for (auto pos = e.first(); n < k && pos < N; pos = e.next(pos)) g.set(pos), n++;
+  return g;
+}
+
+}  // namespace segbitset
+
+#endif
@@ -0,0 +1,83 @@
+#include "segbitset_bsi.h"
+
+#include <algorithm>
+#include <catch2/catch_test_macros.hpp>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+static std::mt19937 rng(std::random_device{}());
+
+TEST_CASE("bit_sliced_index", "[predicates - compare to brute force]") {
+  const std::size_t N = 2000;
+  using BSI = segbitset::bit_sliced_index<N, 10>;
+  auto index = std::make_unique<BSI>();
+  std::vector<std::optional<uint64_t>> e(N);
+  std::uniform_int_distribution<std::size_t> rows(0, N - 1);
+  std::uniform_int_distribution<uint64_t> values(0, 300);  // crowded in the lower values
+  for (int i = 0; i < 3000; i++) {
+    auto pos = rows(rng);
+    if (i % 7) {
+      auto value = values(rng) << (i % 3);  // up to 1200, beyond MAX of 10 bits
+      if (value > BSI::MAX) {
+        REQUIRE_THROWS_AS(index->set(pos, value), std::invalid_argument);
+        continue;
+      }
+      index->set(pos, value), e[pos] = value;
+    } else {
+      index->reset(pos), e[pos].reset();
+    }
+  }
+  std::size_t size = 0;
+  uint64_t sum = 0;
+  for (std::size_t pos = 0; pos < N; pos++) {
+    REQUIRE(index->contains(pos) == e[pos].has_value());
+    if (!e[pos]) continue;
+    REQUIRE(index->get(pos) == *e[pos]);
+    size++, sum += *e[pos];
+  }
+  REQUIRE(index->size() == size);
+  REQUIRE(index->sum() == sum);
+
+  auto require_rows = [&](const BSI::bitset_type& s, auto&& predicate) {
+    for (std::size_t pos = 0; pos < N; pos++) REQUIRE(s.test(pos) == (e[pos] && predicate(*e[pos])));
+  };
+  for (uint64_t c : {uint64_t(0), uint64_t(1), uint64_t(7), uint64_t(100), uint64_t(512), uint64_t(1023),
+                     uint64_t(5000)}) {
+    require_rows(index->eq(c), [&](uint64_t v) { return v == c; });
+    require_rows(index->lt(c), [&](uint64_t v) { return v < c; });
+    require_rows(index->le(c), [&](uint64_t v) { return v <= c; });
+    require_rows(index->between(c / 2, c), [&](uint64_t v) { return c / 2 <= v && v <= c; });
+  }
+  REQUIRE(index->between(10, 9).none());
+
+  BSI::bitset_type filter;
+  uint64_t filtered = 0;
+  for (int i = 0; i < 100; i++) filter.set(rows(rng));
+  for (std::size_t pos = 0; pos < N; pos++)
+    if (filter.test(pos) && e[pos]) filtered += *e[pos];
+  REQUIRE(index->sum(filter) == filtered);
+
+  for (std::size_t k : {std::size_t(0), std::size_t(1), std::size_t(10), std::size_t(333), size, N}) {
+    auto top = index->top_k(k);
+    REQUIRE(top.count() == std::min(k, size));
+    // every row in top is not less than any row out of it.
+    uint64_t least = BSI::MAX, most = 0;
+    for (std::size_t pos = 0; pos < N; pos++) {
+      if (!e[pos]) continue;
+      if (top.test(pos))
+        least = std::min(least, *e[pos]);
+      else
+        most = std::max(most, *e[pos]);
+    }
+    if (k && k < size) REQUIRE(least >= most);
+  }
+  index->reset();
+  REQUIRE(index->size() == 0);
+  REQUIRE(index->lt(BSI::MAX).none());
+  REQUIRE_THROWS_AS(index->get(0), std::out_of_range);
+  REQUIRE_THROWS_AS(index->set(N, 0), std::out_of_range);
+}
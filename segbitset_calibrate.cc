@@ -0,0 +1,26 @@
+// Calibrates the adaptive thresholds of segbitset on this host, and writes them as a config to load at
+// startup with segbitset::load (see segbitset_calibrate.h).
+//
+// Usage: segbitset_calibrate [config]
+//   writes to config if given, to stdout otherwise.
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+#include "segbitset_calibrate.h"
+
+int main(int argc, char* argv[]) {
+  auto t = segbitset::calibrate();
+  if (argc < 2) {
+    segbitset::save(std::cout, t);
+    return 0;
+  }
+  std::ofstream out(argv[1]);
+  if (!out) {
+    std::fprintf(stderr, "cannot write %s\n", argv[1]);
+    return 1;
+  }
+  segbitset::save(out, t);
+  return 0;
+}
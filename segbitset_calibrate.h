@@ -0,0 +1,129 @@
+// Copyright (c) 2024 Chao Wang <hit9@icloud.com>.
+// License: BSD. https://github.com/hit9/segbitset
+// Calibration of the adaptive thresholds of segbitset on the host.
+//
+// The density at which a flat kernel over the whole storage beats the pruned tree walk depends on the CPU
+// (the README's "2%" is one host). calibrate() measures both on uniformly random sets over a range of
+// densities, for each adaptive operation, and returns the crossovers as adaptive_thresholds.
+// It takes about a second, at startup, or offline with segbitset_calibrate writing a small config to load.
+//
+// Usage:
+//   segbitset::thresholds = segbitset::calibrate();  // at startup, or from an offline config:
+//   std::ifstream config("segbitset.calibration");
+//   segbitset::thresholds = segbitset::load(config);
+
+#ifndef __HIT9_SEGBITSET_CALIBRATE
+#define __HIT9_SEGBITSET_CALIBRATE
+
+#include <algorithm>
+#include <chrono>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "segbitset.h"
+
+namespace segbitset {
+
+namespace __calibrate {
+
+// densities of true bits to measure on.
+inline const double DENSITIES[] = {0.00001, 0.0001, 0.0005, 0.001, 0.002, 0.005,
+                                   0.01,    0.02,   0.05,   0.1,   0.3,   0.6};
+inline const size_t ROUNDS = 20;
+inline volatile bool sink;  // avoid compiler optimization away
+
+// returns the best of ROUNDS timings of op, in nanoseconds, after prepare (untimed) each round.
+template <typename Prepare, typename Op>
+double measure(Prepare&& prepare, Op&& op) {
+  double best = 1e18;
+  for (size_t i = 0; i < ROUNDS; i++) {
+    prepare();
+    auto start = std::chrono::steady_clock::now();
+    op();
+    auto end = std::chrono::steady_clock::now();
+    best = std::min(best, std::chrono::duration<double, std::nano>(end - start).count());
+  }
+  return best;
+}
+
+// returns the threshold between the walk and the flat kernel: the midpoint below the lowest block density
+// from which the flat kernel wins at all higher densities, 1 if it never wins.
+inline double crossover(const std::vector<double>& x, const std::vector<double>& walk,
+                        const std::vector<double>& flat) {
+  auto i = x.size();
+  while (i > 0 && flat[i - 1] < walk[i - 1]) --i;
+  if (i == x.size()) return 1;
+  if (i == 0) return 0;
+  return (x[i - 1] + x[i]) / 2;
+}
+
+}  // namespace __calibrate
+
+// calibrate measures the pruned walks against the flat kernels of the adaptive operations on segbitsets of
+// N bits, and returns the thresholds, without applying them. Not thread-safe against other segbitsets in
+// use, since it changes segbitset::thresholds during measurement (and restores it).
+template <size_t N = (1 << 18)>
+adaptive_thresholds calibrate() {
+  using S = segbitset<N>;
+  static_assert(N >= (1 << 12), "too small to calibrate on");
+  const auto saved = thresholds;
+  std::mt19937_64 rng(N);
+  std::uniform_int_distribution<size_t> distribution(0, N - 1);
+  auto a = std::make_unique<S>(), b = std::make_unique<S>(), c = std::make_unique<S>();
+
+  // block densities, and timings of or_assign, equal and reset, walking and flat.
+  std::vector<double> x, walk[3], flat[3];
+  for (auto density : __calibrate::DENSITIES) {
+    a->reset(), b->reset();
+    for (size_t i = 0; i < N * density; i++) a->set(distribution(rng)), b->set(distribution(rng));
+    auto p = a->profile();
+    x.push_back(double(p.nonzero_blocks) / p.blocks);
+    for (int mode = 0; mode < 2; mode++) {
+      auto t = mode ? -1.0 : 1.0;  // always flat, always walk
+      thresholds = {t, t, t};
+      auto& timings = mode ? flat : walk;
+      timings[0].push_back(__calibrate::measure([&] { *c = *a; }, [&] { *c |= *b; }));
+      timings[1].push_back(__calibrate::measure([&] { *c = *a; }, [&] { __calibrate::sink = *c == *a; }));
+      timings[2].push_back(__calibrate::measure([&] { *c = *a; }, [&] { c->reset(); }));
+    }
+  }
+  thresholds = saved;
+  return {__calibrate::crossover(x, walk[0], flat[0]), __calibrate::crossover(x, walk[1], flat[1]),
+          __calibrate::crossover(x, walk[2], flat[2])};
+}
+
+// writes given thresholds as a config of lines "name value".
+inline void save(std::ostream& out, const adaptive_thresholds& t) {
+  out << "or_assign " << t.or_assign << '\n';
+  out << "equal " << t.equal << '\n';
+  out << "reset " << t.reset << '\n';
+}
+
+// reads thresholds from a config written by save(), missing ones keep their defaults.
+// throws std::runtime_error on unknown names or malformed values.
+inline adaptive_thresholds load(std::istream& in) {
+  adaptive_thresholds t;
+  std::string name;
+  double value;
+  while (in >> name) {
+    if (!(in >> value)) throw std::runtime_error("segbitset::load: bad value of " + name);
+    if (name == "or_assign")
+      t.or_assign = value;
+    else if (name == "equal")
+      t.equal = value;
+    else if (name == "reset")
+      t.reset = value;
+    else
+      throw std::runtime_error("segbitset::load: unknown threshold " + name);
+  }
+  return t;
+}
+
+}  // namespace segbitset
+
+#endif
@@ -0,0 +1,34 @@
+#include "segbitset_calibrate.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <sstream>
+#include <stdexcept>
+
+TEST_CASE("calibrate", "[thresholds are densities]") {
+  auto saved = segbitset::thresholds;
+  auto t = segbitset::calibrate<1 << 12>();
+  for (auto v : {t.or_assign, t.equal, t.reset}) {
+    REQUIRE(v >= 0);
+    REQUIRE(v <= 1);
+  }
+  REQUIRE(segbitset::thresholds.or_assign == saved.or_assign);  // not applied
+}
+
+TEST_CASE("calibrate", "[save and load config]") {
+  segbitset::adaptive_thresholds t{0.125, 1, -1};
+  std::stringstream ss;
+  segbitset::save(ss, t);
+  auto u = segbitset::load(ss);
+  REQUIRE(u.or_assign == 0.125);
+  REQUIRE(u.equal == 1);
+  REQUIRE(u.reset == -1);
+
+  std::stringstream partial("reset 0.5\n");
+  u = segbitset::load(partial);
+  REQUIRE(u.reset == 0.5);
+  REQUIRE(u.or_assign == segbitset::adaptive_thresholds{}.or_assign);
+
+  std::stringstream unknown("and_assign 0.5\n"), malformed("equal x\n");
+  REQUIRE_THROWS_AS(segbitset::load(unknown), std::runtime_error);
+  REQUIRE_THROWS_AS(segbitset::load(malformed), std::runtime_error);
+}
@@ -0,0 +1,188 @@
+// Copyright (c) 2024 Chao Wang <hit9@icloud.com>.
+// License: BSD. https://github.com/hit9/segbitset
+// A lock-free segbitset for concurrent set, reset, test, next and pop_first.
+//
+// The tree is a perfect binary tree of OR summaries over bit_ceil(N) leaves, in heap order, stored in atomic
+// words, so the parent of node x is x/2 and the leaf of position pos is bit_ceil(N) + pos.
+//
+//  set(pos):   sets the leaf, then sets each ancestor which is not set yet. Ancestors are read before being
+//              written, so hot upper levels stay shared in caches instead of bouncing between cores.
+//  reset(pos): clears the leaf, then clears each ancestor whose children are both empty. After clearing an
+//              ancestor, its children are checked again, and if a concurrent set got in between, the ancestor
+//              and the ones above are set back.
+//
+// A summary may be set while its subtree is empty for a while, so searches backtrack on empty subtrees.
+// A summary over a true bit may be cleared only between the two checks of a racing reset, which sets it back.
+// Summaries are exact again once no writes are in flight.
+// next, first and pop_first are weakly consistent: they never report a position that wasn't true during
+// the call, but may miss bits set or restored concurrently.
+// count, reset() and the other whole-set operations aren't atomic with respect to concurrent writes.
+//
+// Usage:
+//   auto s = std::make_unique<segbitset::concurrent_segbitset<N>>();
+//   s->set(3);                 // from any thread
+//   auto pos = s->pop_first();  // from any thread, N if empty
+
+#ifndef __HIT9_SEGBITSET_CONCURRENT
+#define __HIT9_SEGBITSET_CONCURRENT
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+#include "segbitset_heap.h"
+
+namespace segbitset {
+
+using size_t = std::size_t;
+
+template <size_t N>
+class concurrent_segbitset {
+  static_assert(N > 0);
+  static constexpr size_t P = std::bit_ceil(N);  // number of leaves
+  static constexpr size_t W = (2 * P + 63) >> 6;  // number of words, node 0 is unused
+
+ public:
+  concurrent_segbitset() noexcept = default;
+  concurrent_segbitset(const concurrent_segbitset&) = delete;
+  concurrent_segbitset& operator=(const concurrent_segbitset&) = delete;
+
+  // returns the number of bits that this segbitset holds
+  constexpr size_t size() const noexcept { return N; }
+  // returns the number of bits set to true.
+  size_t count() const noexcept;
+  // returns the value of the bit at the position pos (counting from 0).
+  // throws std::out_of_range if pos is invalid.
+  bool test(size_t pos) const;
+  // checks if any of the bits are set to true
+  bool any() const noexcept { return __test(1); }
+  // checks if none of the bits are set to true
+  bool none() const noexcept { return !any(); }
+  // sets the bit at position pos to true.
+  // throws std::out_of_range if pos is invalid.
+  concurrent_segbitset& set(size_t pos);
+  // sets the bit at position pos to false.
+  // throws std::out_of_range if pos is invalid.
+  concurrent_segbitset& reset(size_t pos);
+  // sets the bit at position pos to false, returns true if it was true. Of racing callers on a true bit,
+  // exactly one gets true, e.g. to claim the bit found by first() or next().
+  // throws std::out_of_range if pos is invalid.
+  bool try_reset(size_t pos);
+  // sets all bits to false.
+  concurrent_segbitset& reset() noexcept;
+  // find the first position where stores a true bit, returns size of this segbitset if not found.
+  size_t first() const noexcept { return __find(0); }
+  // find the next position where stores a true bit from the right part of given position, returns size of
+  // this segbitset if not found.
+  size_t next(size_t pos) const noexcept { return pos + 1 < N ? __find(pos + 1) : N; }
+  // finds the first position where stores a true bit and sets it to false, returns the position, or size of
+  // this segbitset if not found. Each true bit is popped by exactly one of racing callers.
+  size_t pop_first() noexcept;
+
+ private:
+  std::atomic<uint64_t> words[W]{};
+
+  bool __test(size_t x) const noexcept { return (words[x >> 6].load() >> (x & 63)) & 1; }
+  void __set(size_t x) noexcept { words[x >> 6].fetch_or(uint64_t(1) << (x & 63)); }
+  // clears node x, returns true if it was set.
+  bool __clear(size_t x) noexcept {
+    auto mask = uint64_t(1) << (x & 63);
+    return words[x >> 6].fetch_and(~mask) & mask;
+  }
+  // sets node x and its ancestors which aren't set.
+  void __set_to_root(size_t x) noexcept {
+    for (; x; x >>= 1)
+      if (!__test(x)) __set(x);
+  }
+  void __clear_to_root(size_t x) noexcept;  // x is a node which may be empty
+  size_t __find(size_t pos) const noexcept;
+};
+
+template <size_t N>
+size_t concurrent_segbitset<N>::count() const noexcept {
+  if constexpr (P < 64) {
+    return std::popcount((words[0].load() >> P) & ((uint64_t(1) << P) - 1));
+  } else {
+    size_t cnt = 0;
+    for (size_t i = P >> 6; i < W; i++) cnt += std::popcount(words[i].load());
+    return cnt;
+  }
+}
+
+template <size_t N>
+bool concurrent_segbitset<N>::test(size_t pos) const {
+  if (pos >= N) throw std::out_of_range("segbitset:test out of range");
+  return __test(P + pos);
+}
+
+template <size_t N>
+concurrent_segbitset<N>& concurrent_segbitset<N>::set(size_t pos) {
+  if (pos >= N) throw std::out_of_range("segbitset:set out of range");
+  __set(P + pos);
+  __set_to_root((P + pos) >> 1);
+  // the bit may be reset before the ancestors are set, and the reset may have passed them already.
+  if (!__test(P + pos)) __clear_to_root(P + pos);
+  return *this;
+}
+
+template <size_t N>
+concurrent_segbitset<N>& concurrent_segbitset<N>::reset(size_t pos) {
+  if (pos >= N) throw std::out_of_range("segbitset:reset out of range");
+  if (__clear(P + pos)) __clear_to_root(P + pos);
+  return *this;
+}
+
+template <size_t N>
+bool concurrent_segbitset<N>::try_reset(size_t pos) {
+  if (pos >= N) throw std::out_of_range("segbitset:try_reset out of range");
+  if (!__clear(P + pos)) return false;
+  __clear_to_root(P + pos);
+  return true;
+}
+
+template <size_t N>
+concurrent_segbitset<N>& concurrent_segbitset<N>::reset() noexcept {
+  for (auto& w : words) w.store(0);
+  return *this;
+}
+
+template <size_t N>
+size_t concurrent_segbitset<N>::pop_first() noexcept {
+  for (auto pos = __find(0); pos < N; pos = next(pos)) {
+    if (__clear(P + pos)) {
+      __clear_to_root(P + pos);
+      return pos;
+    }
+  }
+  return N;
+}
+
+template <size_t N>
+void concurrent_segbitset<N>::__clear_to_root(size_t x) noexcept {
+  while (x > 1) {
+    // x is empty, clears the parent if the sibling is empty too.
+    if (__test(x) || __test(x ^ 1)) return;
+    __clear(x >> 1);
+    // a set may have happened on either child after the check, and it may have stopped at the parent
+    // before it was cleared, so restores the parent for it. The children may be emptied again before the
+    // restore, so checks them again.
+    if (__test(x) || __test(x ^ 1))
+      __set_to_root(x >> 1);
+    else
+      x >>= 1;
+  }
+}
+
+// returns the first true position at or after pos, N if not found.
+template <size_t N>
+size_t concurrent_segbitset<N>::__find(size_t pos) const noexcept {
+  if (pos >= N) return N;
+  auto x = __heap_find<P>(P + pos, [this](size_t x) { return __test(x); });
+  return x ? x - P : N;
+}
+
+}  // namespace segbitset
+
+#endif
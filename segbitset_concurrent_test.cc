@@ -0,0 +1,143 @@
+#include "segbitset_concurrent.h"
+
+#include <algorithm>
+#include <bitset>
+#include <catch2/catch_test_macros.hpp>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+static std::mt19937 rng(std::random_device{}());
+
+TEST_CASE("concurrent", "[single thread - compare to bitset]") {
+  const std::size_t N = 1000;
+  std::uniform_int_distribution<std::size_t> distribution(0, N - 1);
+  segbitset::concurrent_segbitset<N> s;
+  std::bitset<N> b;
+  REQUIRE(s.none());
+  REQUIRE(s.first() == N);
+  REQUIRE(s.pop_first() == N);
+  for (int i = 0; i < 10000; i++) {
+    auto pos = distribution(rng);
+    switch (i % 4) {
+      case 0:
+      case 1:
+        s.set(pos), b.set(pos);
+        break;
+      case 2:
+        s.reset(pos), b.reset(pos);
+        break;
+      case 3:
+        REQUIRE(s.test(pos) == b.test(pos));
+        break;
+    }
+  }
+  REQUIRE(s.count() == b.count());
+  REQUIRE(s.any() == b.any());
+  std::size_t cnt = 0;
+  for (auto pos = s.first(); pos < N; pos = s.next(pos)) {
+    REQUIRE(b[pos]);
+    ++cnt;
+  }
+  REQUIRE(cnt == b.count());
+  for (std::size_t pos = 0; pos < N; pos++)
+    if (b[pos]) REQUIRE(s.pop_first() == pos);
+  REQUIRE(s.pop_first() == N);
+  REQUIRE(s.none());
+  REQUIRE_THROWS_AS(s.set(N), std::out_of_range);
+  REQUIRE_THROWS_AS(s.test(N), std::out_of_range);
+}
+
+TEST_CASE("concurrent", "[small sizes]") {
+  segbitset::concurrent_segbitset<1> s1;
+  s1.set(0);
+  REQUIRE(s1.any());
+  REQUIRE(s1.count() == 1);
+  REQUIRE(s1.next(0) == 1);
+  REQUIRE(s1.pop_first() == 0);
+  REQUIRE(s1.none());
+  segbitset::concurrent_segbitset<37> s2;
+  s2.set(36).set(5);
+  REQUIRE(s2.count() == 2);
+  REQUIRE(s2.first() == 5);
+  REQUIRE(s2.next(5) == 36);
+  s2.reset(5);
+  REQUIRE(s2.first() == 36);
+}
+
+TEST_CASE("concurrent", "[each bit is popped exactly once]") {
+  const std::size_t N = 100000, T = 8;
+  auto s = std::make_unique<segbitset::concurrent_segbitset<N>>();
+  std::vector<std::vector<std::size_t>> popped(T);
+  std::vector<std::thread> threads;
+  for (std::size_t t = 0; t < T; t++) {
+    threads.emplace_back([&, t] {
+      // sets positions of its own, and pops from all.
+      for (auto pos = t; pos < N; pos += T) {
+        s->set(pos);
+        if (pos % 3 == 0) popped[t].push_back(s->pop_first());
+      }
+      for (std::size_t pos; (pos = s->pop_first()) < N;) popped[t].push_back(pos);
+    });
+  }
+  for (auto& th : threads) th.join();
+  std::vector<std::size_t> all;
+  for (auto& v : popped) all.insert(all.end(), v.begin(), v.end());
+  all.erase(std::remove(all.begin(), all.end(), N), all.end());  // pops on an empty set by then
+  std::sort(all.begin(), all.end());
+  REQUIRE(all.size() == N);
+  for (std::size_t i = 0; i < N; i++) REQUIRE(all[i] == i);
+  REQUIRE(s->none());
+}
+
+TEST_CASE("concurrent", "[racing set and reset keep summaries]") {
+  const std::size_t N = 4096, T = 8;
+  auto s = std::make_unique<segbitset::concurrent_segbitset<N>>();
+  std::vector<std::bitset<N>> expected(T);
+  std::vector<std::thread> threads;
+  for (std::size_t t = 0; t < T; t++) {
+    threads.emplace_back([&, t, seed = rng()] {
+      // neighbouring positions belong to different threads, so that they race on the same summaries.
+      std::mt19937 r(seed);
+      std::uniform_int_distribution<std::size_t> distribution(0, N / T - 1);
+      for (int i = 0; i < 100000; i++) {
+        auto pos = distribution(r) * T + t;
+        if (r() & 1)
+          s->set(pos), expected[t].set(pos);
+        else
+          s->reset(pos), expected[t].reset(pos);
+      }
+    });
+  }
+  for (auto& th : threads) th.join();
+  std::bitset<N> b;
+  for (auto& e : expected) b |= e;
+  REQUIRE(s->count() == b.count());
+  REQUIRE(s->any() == b.any());
+  std::size_t cnt = 0;
+  for (auto pos = s->first(); pos < N; pos = s->next(pos)) {
+    REQUIRE(b[pos]);
+    ++cnt;
+  }
+  REQUIRE(cnt == b.count());
+}
+
+TEST_CASE("concurrent", "[try_reset claims a bit exactly once]") {
+  const std::size_t N = 10000, T = 4;
+  auto s = std::make_unique<segbitset::concurrent_segbitset<N>>();
+  for (std::size_t pos = 0; pos < N; pos++) s->set(pos);
+  std::vector<std::size_t> claimed(T);
+  std::vector<std::thread> threads;
+  for (std::size_t t = 0; t < T; t++) {
+    threads.emplace_back([&, t] {
+      for (std::size_t pos = 0; pos < N; pos++) claimed[t] += s->try_reset(pos);
+    });
+  }
+  for (auto& th : threads) th.join();
+  std::size_t total = 0;
+  for (auto n : claimed) total += n;
+  REQUIRE(total == N);
+  REQUIRE(s->none());
+  REQUIRE(!s->try_reset(0));
+}
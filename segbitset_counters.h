@@ -0,0 +1,206 @@
+// Copyright (c) 2024 Chao Wang <hit9@icloud.com>.
+// License: BSD. https://github.com/hit9/segbitset
+// An array of N small saturating counters, packed in 64-bit words, under a segbitset of non-zero words.
+//
+// Counters are Bits (4 or 8) wide, 64/Bits of them per word, e.g. the counters of a counting Bloom filter.
+// Bit w of the segbitset above tells whether word w has a non-zero counter, which is the OR-of-nonzero
+// summary of its counters, so searches for non-zero counters skip empty ranges like segbitset does:
+//
+//   increment/decrement: O(1) on the word, plus O(logN) to update the summary if the word turns (non-)zero.
+//   next_nonzero(pos), any(first, last): scans the word of pos, then next() on the segbitset.
+//   merge(other): |= on the summaries, then saturating adds (SWAR) only on the non-zero words of other.
+//
+// Counters saturate at 2^Bits-1, and a saturated counter is never decremented, since its true count is lost,
+// as counting Bloom filters do.
+//
+// Usage:
+//   auto c = std::make_unique<segbitset::counter_array<1 << 20>>();  // 4-bit counters
+//   for (auto h : hashes(key)) c->increment(h % c->size());
+//   bool maybe = std::ranges::all_of(hashes(key), [&](auto h) { return c->get(h % c->size()); });
+//   auto pos = c->next_nonzero(100);  // first non-zero counter after 100, N if not found
+
+#ifndef __HIT9_SEGBITSET_COUNTERS
+#define __HIT9_SEGBITSET_COUNTERS
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+#include "segbitset.h"
+
+namespace segbitset {
+
+template <size_t N, unsigned Bits = 4>
+class counter_array {
+  static_assert(N > 0);
+  static_assert(Bits == 4 || Bits == 8, "counters are 4 or 8 bits");
+  static constexpr size_t K = 64 / Bits;        // counters per word
+  static constexpr size_t W = (N + K - 1) / K;  // number of words
+  // the lowest bit and the highest bit of each lane.
+  static constexpr uint64_t LOW = ~uint64_t(0) / ((uint64_t(1) << Bits) - 1);
+  static constexpr uint64_t HIGH = LOW << (Bits - 1);
+
+ public:
+  using value_type = unsigned;
+  // the saturated value of a counter.
+  static constexpr value_type MAX = (1u << Bits) - 1;
+
+  constexpr counter_array() noexcept = default;
+
+  // returns the number of counters, that is N.
+  constexpr size_t size() const noexcept { return N; }
+  // returns the value of the counter at pos.
+  // throws std::out_of_range if pos is invalid.
+  constexpr value_type get(size_t pos) const {
+    if (pos >= N) throw std::out_of_range("counter_array::get pos >= N");
+    return __get(pos);
+  }
+  constexpr value_type operator[](size_t pos) const { return get(pos); }
+
+  // adds delta to the counter at pos, saturating at MAX, returns the new value.
+  // throws std::out_of_range if pos is invalid.
+  constexpr value_type increment(size_t pos, value_type delta = 1);
+  // subtracts delta from the counter at pos, down to 0, returns the new value. Saturated counters stay MAX.
+  // throws std::out_of_range if pos is invalid.
+  constexpr value_type decrement(size_t pos, value_type delta = 1);
+  // sets the counter at pos to 0.
+  // throws std::out_of_range if pos is invalid.
+  constexpr void reset(size_t pos);
+  // sets all counters to 0, walking only the non-zero words.
+  constexpr void clear() noexcept;
+
+  // checks if any counter is non-zero, O(1).
+  constexpr bool any() const noexcept { return s.any(); }
+  constexpr bool none() const noexcept { return s.none(); }
+  // checks if any counter in positions [first, last) is non-zero.
+  constexpr bool any(size_t first, size_t last) const noexcept {
+    return first < last && __find(first) < last;
+  }
+  // finds the first non-zero counter, returns N if not found.
+  constexpr size_t first_nonzero() const noexcept { return __find(0); }
+  // finds the next non-zero counter after given position, returns N if not found.
+  constexpr size_t next_nonzero(size_t pos) const noexcept { return pos + 1 < N ? __find(pos + 1) : N; }
+  // iterates all non-zero counters from left to right, calling cb(pos, value) for each.
+  template <typename Callback>
+  constexpr void foreach_nonzero(Callback&& cb) const;
+
+  // adds the counters of other to this one's, position by position, saturating at MAX.
+  constexpr counter_array& merge(const counter_array& other) noexcept;
+
+  constexpr bool operator==(const counter_array& o) const noexcept { return s == o.s && __equal(o); }
+
+  // returns the segbitset of non-zero words, e.g. for profile().
+  constexpr const segbitset<W>& words() const noexcept { return s; }
+
+ private:
+  uint64_t a[W]{};  // packed counters
+  segbitset<W> s;   // non-zero words
+
+  constexpr value_type __get(size_t pos) const noexcept {
+    return (a[pos / K] >> (pos % K * Bits)) & MAX;
+  }
+  // sets the counter at pos to value, updating the summary if the word turns zero or non-zero.
+  constexpr void __put(size_t pos, value_type value) noexcept;
+  // returns the first non-zero counter at or after pos, N if not found.
+  constexpr size_t __find(size_t pos) const noexcept;
+  constexpr bool __equal(const counter_array& o) const noexcept;
+  // returns the lane-wise saturating sum of x and y.
+  static constexpr uint64_t __saturating_add(uint64_t x, uint64_t y) noexcept;
+};
+
+template <size_t N, unsigned Bits>
+constexpr void counter_array<N, Bits>::__put(size_t pos, value_type value) noexcept {
+  auto w = pos / K, shift = pos % K * Bits;
+  bool was = a[w];
+  a[w] = (a[w] & ~(uint64_t(MAX) << shift)) | (uint64_t(value) << shift);
+  if (was != bool(a[w])) s.set(w, a[w]);
+}
+
+template <size_t N, unsigned Bits>
+constexpr typename counter_array<N, Bits>::value_type counter_array<N, Bits>::increment(size_t pos,
+                                                                                       value_type delta) {
+  if (pos >= N) throw std::out_of_range("counter_array::increment pos >= N");
+  auto v = __get(pos);
+  v = delta >= MAX - v ? MAX : v + delta;
+  __put(pos, v);
+  return v;
+}
+
+template <size_t N, unsigned Bits>
+constexpr typename counter_array<N, Bits>::value_type counter_array<N, Bits>::decrement(size_t pos,
+                                                                                       value_type delta) {
+  if (pos >= N) throw std::out_of_range("counter_array::decrement pos >= N");
+  auto v = __get(pos);
+  if (v == MAX) return v;  // saturated, the true count is unknown
+  v = delta >= v ? 0 : v - delta;
+  __put(pos, v);
+  return v;
+}
+
+template <size_t N, unsigned Bits>
+constexpr void counter_array<N, Bits>::reset(size_t pos) {
+  if (pos >= N) throw std::out_of_range("counter_array::reset pos >= N");
+  __put(pos, 0);
+}
+
+template <size_t N, unsigned Bits>
+constexpr void counter_array<N, Bits>::clear() noexcept {
+  s.foreach1([&](size_t w) { a[w] = 0; });
+  s.reset();
+}
+
+template <size_t N, unsigned Bits>
+constexpr size_t counter_array<N, Bits>::__find(size_t pos) const noexcept {
+  if (pos >= N) return N;
+  auto w = pos / K;
+  // lanes of non-zero counters at or after pos in its word, then the first non-zero word after it.
+  auto m = a[w] & (~uint64_t(0) << (pos % K * Bits));
+  if (!m) {
+    w = s.next(w);
+    if (w >= W) return N;
+    m = a[w];
+  }
+  return w * K + std::countr_zero(m) / Bits;
+}
+
+template <size_t N, unsigned Bits>
+template <typename Callback>
+constexpr void counter_array<N, Bits>::foreach_nonzero(Callback&& cb) const {
+  s.foreach1([&](size_t w) {
+    for (auto m = a[w]; m;) {
+      auto lane = std::countr_zero(m) / Bits;
+      cb(w * K + lane, value_type((a[w] >> (lane * Bits)) & MAX));
+      m &= ~(uint64_t(MAX) << (lane * Bits));
+    }
+  });
+}
+
+template <size_t N, unsigned Bits>
+constexpr uint64_t counter_array<N, Bits>::__saturating_add(uint64_t x, uint64_t y) noexcept {
+  // adds the low Bits-1 bits of each lane without carries across lanes, then adds the high bits by xor.
+  auto low = (x & ~HIGH) + (y & ~HIGH);
+  auto sum = low ^ ((x ^ y) & HIGH);
+  // a lane overflows if it carries out of its high bit, then it's filled with MAX.
+  auto overflow = ((x & y) | ((x | y) & ~sum)) & HIGH;
+  return sum | ((overflow >> (Bits - 1)) * MAX);
+}
+
+template <size_t N, unsigned Bits>
+constexpr counter_array<N, Bits>& counter_array<N, Bits>::merge(const counter_array& other) noexcept {
+  // zero words of other leave ours unchanged, and a sum is non-zero if either is.
+  other.s.foreach1([&](size_t w) { a[w] = __saturating_add(a[w], other.a[w]); });
+  s |= other.s;
+  return *this;
+}
+
+template <size_t N, unsigned Bits>
+constexpr bool counter_array<N, Bits>::__equal(const counter_array& o) const noexcept {
+  bool ans = true;
+  s.foreach1([&](size_t w) { ans = ans && a[w] == o.a[w]; });
+  return ans;
+}
+
+}  // namespace segbitset
+
+#endif
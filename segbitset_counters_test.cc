@@ -0,0 +1,101 @@
+#include "segbitset_counters.h"
+
+#include <algorithm>
+#include <catch2/catch_template_test_macros.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+static std::mt19937 rng(std::random_device{}());
+
+template <typename C>
+void require_equal(const C& c, const std::vector<unsigned>& e) {
+  for (std::size_t pos = 0; pos < e.size(); pos++) REQUIRE(c.get(pos) == e[pos]);
+  std::vector<std::size_t> nonzero, expected;
+  for (auto pos = c.first_nonzero(); pos < e.size(); pos = c.next_nonzero(pos)) nonzero.push_back(pos);
+  for (std::size_t pos = 0; pos < e.size(); pos++)
+    if (e[pos]) expected.push_back(pos);
+  REQUIRE(nonzero == expected);
+  nonzero.clear();
+  c.foreach_nonzero([&](std::size_t pos, unsigned value) {
+    REQUIRE(value == e[pos]);
+    nonzero.push_back(pos);
+  });
+  REQUIRE(nonzero == expected);
+  REQUIRE(c.any() == !expected.empty());
+}
+
+template <unsigned Bits>
+struct bits {
+  static constexpr unsigned value = Bits;
+};
+
+TEMPLATE_TEST_CASE("counter_array", "[compare to vector]", bits<4>, bits<8>) {
+  const std::size_t N = 1001;
+  using C = segbitset::counter_array<N, TestType::value>;
+  std::uniform_int_distribution<std::size_t> distribution(0, N - 1);
+  std::uniform_int_distribution<unsigned> deltas(1, 20);
+  C c, d;
+  std::vector<unsigned> e(N), f(N);
+  require_equal(c, e);
+  for (int i = 0; i < 5000; i++) {
+    auto pos = distribution(rng) % (i < 2500 ? 100 : N);  // crowded then sparse
+    auto delta = deltas(rng);
+    switch (i % 5) {
+      case 0:
+      case 1:
+        REQUIRE(c.increment(pos, delta) == (e[pos] = std::min(e[pos] + delta, C::MAX)));
+        break;
+      case 2:
+        if (e[pos] != C::MAX) e[pos] = delta >= e[pos] ? 0 : e[pos] - delta;
+        REQUIRE(c.decrement(pos, delta) == e[pos]);
+        break;
+      case 3:
+        c.reset(pos), e[pos] = 0;
+        break;
+      case 4:
+        d.increment(pos), f[pos] = std::min(f[pos] + 1, C::MAX);
+        break;
+    }
+    if (i % 500 == 0) require_equal(c, e);
+  }
+  require_equal(c, e);
+  for (int i = 0; i < 100; i++) {
+    auto first = distribution(rng), last = distribution(rng);
+    REQUIRE(c.any(first, last) == std::any_of(e.begin() + first, e.begin() + std::max(first, last),
+                                                [](unsigned v) { return v; }));
+  }
+  c.merge(d);
+  for (std::size_t pos = 0; pos < N; pos++) e[pos] = std::min(e[pos] + f[pos], C::MAX);
+  require_equal(c, e);
+  C copy = c;
+  REQUIRE(copy == c);
+  if (copy.get(N - 1))
+    copy.reset(N - 1);
+  else
+    copy.increment(N - 1);
+  REQUIRE(!(copy == c));
+  c.clear();
+  REQUIRE(c.none());
+  REQUIRE(c.first_nonzero() == N);
+  REQUIRE_THROWS_AS(c.increment(N), std::out_of_range);
+  REQUIRE_THROWS_AS(c.get(N), std::out_of_range);
+}
+
+TEST_CASE("counter_array", "[saturation and constexpr]") {
+  static constexpr auto c = [] {
+    segbitset::counter_array<100> c, d;
+    for (int i = 0; i < 20; i++) c.increment(7);
+    c.increment(50, 3), d.increment(50, 14), d.increment(99);
+    c.decrement(7);  // saturated, stays
+    return c.merge(d);
+  }();
+  static_assert(c.get(7) == 15);
+  static_assert(c.get(50) == 15);
+  static_assert(c.first_nonzero() == 7);
+  static_assert(c.next_nonzero(7) == 50);
+  static_assert(c.next_nonzero(50) == 99);
+  static_assert(c.next_nonzero(99) == 100);
+  static_assert(!c.any(8, 50) && c.any(8, 51));
+}
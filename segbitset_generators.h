@@ -0,0 +1,153 @@
+// Copyright (c) 2024 Chao Wang <hit9@icloud.com>.
+// License: BSD. https://github.com/hit9/segbitset
+// Data distribution generators for segbitset tests and benchmarks.
+//
+// Uniformly random positions are the worst case for subtree pruning, and unlike most real data,
+// these generators produce bit patterns of other shapes, so that pruning wins and losses are visible
+// per distribution:
+//
+//   uniform:       each bit is set independently.
+//   clustered:     bits are set in hot zones of 4096 bits, all other zones are empty.
+//   zipfian:       blocks of 64 bits are picked with Zipf law (s = 1), a few blocks take most bits.
+//   runs:          runs of consecutive true bits separated by gaps, both of geometric lengths.
+//   periodic:      the same pattern repeated with a fixed period (strided for sparse densities).
+//   dense_blocks:  a few large blocks, each of which is 90% set, everything else is 0.
+//
+// Usage:
+//   segbitset::generators::generate(segbitset::generators::distribution::runs, N, 0.01, rng,
+//                                   [&](size_t pos) { s.set(pos); });
+
+#ifndef __HIT9_SEGBITSET_GENERATORS
+#define __HIT9_SEGBITSET_GENERATORS
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+
+namespace segbitset {
+namespace generators {
+
+using size_t = std::size_t;
+
+enum class distribution { uniform, clustered, zipfian, runs, periodic, dense_blocks };
+
+// all distributions, to iterate over.
+inline constexpr distribution all[] = {distribution::uniform, distribution::clustered,
+                                       distribution::zipfian, distribution::runs,
+                                       distribution::periodic, distribution::dense_blocks};
+
+// returns the name of given distribution.
+constexpr const char* name(distribution d) {
+  switch (d) {
+    case distribution::uniform:
+      return "uniform";
+    case distribution::clustered:
+      return "clustered";
+    case distribution::zipfian:
+      return "zipfian";
+    case distribution::runs:
+      return "runs";
+    case distribution::periodic:
+      return "periodic";
+    case distribution::dense_blocks:
+      return "dense_blocks";
+  }
+  return "";
+}
+
+// calls set(pos) for each position in [begin, end) independently with probability p.
+// Costs O(number of calls) by skipping geometric distributed gaps.
+template <typename RNG, typename Set>
+void bernoulli(size_t begin, size_t end, double p, RNG& rng, Set&& set) {
+  if (p <= 0 || begin >= end) return;
+  if (p >= 1) {
+    for (auto pos = begin; pos < end; pos++) set(pos);
+    return;
+  }
+  std::geometric_distribution<size_t> skip(p);
+  for (auto pos = begin + skip(rng); pos < end; pos += 1 + skip(rng)) set(pos);
+}
+
+// calls set(pos) for positions in [0, n) drawn from distribution d, for about density * n distinct
+// positions on average (zipfian may yield less for saturated hot blocks).
+// The same position is never set twice, except for zipfian.
+template <typename RNG, typename Set>
+void generate(distribution d, size_t n, double density, RNG& rng, Set&& set) {
+  density = std::clamp(density, 0.0, 1.0);
+  if (!n || density == 0) return;
+  std::uniform_real_distribution<double> real(0, 1);
+
+  switch (d) {
+    case distribution::uniform:
+      bernoulli(0, n, density, rng, set);
+      return;
+
+    case distribution::clustered: {
+      // a zone is hot with probability q, bits in hot zones are set with probability density / q.
+      const size_t zone = 4096;
+      double q = std::min(1.0, density * 16);
+      for (size_t begin = 0; begin < n; begin += zone)
+        if (real(rng) < q) bernoulli(begin, std::min(n, begin + zone), density / q, rng, set);
+      return;
+    }
+
+    case distribution::zipfian: {
+      // rank r of a block is drawn with P(r) ~ 1/r by inverting the continuous CDF,
+      // ranks are scattered over blocks with a multiplicative hash.
+      const size_t blocks = (n + 63) >> 6;
+      std::uniform_int_distribution<size_t> offset(0, 63);
+      auto m = size_t(density * n);
+      for (size_t i = 0; i < m; i++) {
+        auto rank = size_t(std::exp(real(rng) * std::log(double(blocks) + 1))) - 1;
+        auto block = (std::min(rank, blocks - 1) * uint64_t(0x9E3779B97F4A7C15)) % blocks;
+        auto pos = (block << 6) + offset(rng);
+        if (pos < n) set(pos);
+      }
+      return;
+    }
+
+    case distribution::runs: {
+      // run lengths have a mean of 64, gap lengths are chosen to keep the density.
+      const double run = 64;
+      if (density == 1) return bernoulli(0, n, 1, rng, set);
+      std::geometric_distribution<size_t> runs(1 / run), gaps(density / (run * (1 - density) + density));
+      for (auto pos = gaps(rng); pos < n; pos += gaps(rng)) {
+        auto end = std::min(n, pos + 1 + runs(rng));
+        for (; pos < end; pos++) set(pos);
+      }
+      return;
+    }
+
+    case distribution::periodic: {
+      // sparse: one bit every 1/density bits; dense: a run of density * 64 bits every 64 bits.
+      const size_t period = density < 1.0 / 64 ? size_t(1 / density) : 64;
+      const size_t k = std::max<size_t>(1, size_t(density * period + 0.5));
+      auto phase = std::uniform_int_distribution<size_t>(0, period - 1)(rng);
+      for (size_t begin = phase; begin < n; begin += period)
+        for (auto pos = begin; pos < std::min(n, begin + k); pos++) set(pos);
+      return;
+    }
+
+    case distribution::dense_blocks: {
+      // 8 blocks evenly spaced with random offsets, each block is 90% set.
+      const size_t k = 8;
+      const double inner = std::max(0.9, density);
+      auto size = std::min(n / k, size_t(density * n / (k * inner)) + 1);
+      if (!size) return bernoulli(0, n, density, rng, set);
+      auto stride = n / k;
+      std::uniform_int_distribution<size_t> offset(0, stride - size);
+      for (size_t i = 0; i < k; i++) {
+        auto begin = i * stride + offset(rng);
+        bernoulli(begin, begin + size, inner, rng, set);
+      }
+      return;
+    }
+  }
+}
+
+}  // namespace generators
+}  // namespace segbitset
+
+#endif
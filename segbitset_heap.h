@@ -0,0 +1,40 @@
+// Copyright (c) 2024 Chao Wang <hit9@icloud.com>.
+// License: BSD. https://github.com/hit9/segbitset
+// Searches on perfect binary trees of summaries in heap order, shared by concurrent_segbitset and segmap.
+//
+// A tree of P leaves (P a power of 2) is stored in heap order: the root is node 1, the children of node x are
+// 2x and 2x+1, and the leaves are nodes P .. 2P-1. A node is non-empty if anything is below it.
+
+#ifndef __HIT9_SEGBITSET_HEAP
+#define __HIT9_SEGBITSET_HEAP
+
+#include <cstddef>
+
+namespace segbitset {
+
+// returns the first non-empty leaf at or after leaf x, 0 if not found, skipping empty subtrees.
+// nonempty(node) tells whether a node is non-empty. A subtree found empty while descending into it, as on
+// concurrent trees, is skipped by climbing again.
+template <std::size_t P, typename Nonempty>
+constexpr std::size_t __heap_find(std::size_t x, Nonempty&& nonempty) noexcept {
+  if (nonempty(x)) return x;
+  while (true) {
+    // climbs to the nearest left child on the path whose right sibling isn't empty.
+    while (x > 1 && ((x & 1) || !nonempty(x + 1))) x >>= 1;
+    if (x <= 1) return 0;
+    // descends to the leftmost non-empty leaf of the sibling.
+    for (++x; x < P;) {
+      if (nonempty(x << 1))
+        x <<= 1;
+      else if (nonempty(x << 1 | 1))
+        x = x << 1 | 1;
+      else
+        break;  // emptied concurrently, goes on to the right.
+    }
+    if (x >= P) return x;
+  }
+}
+
+}  // namespace segbitset
+
+#endif
@@ -0,0 +1,169 @@
+// Benchmark on latency distributions of point operations: set(pos), reset(pos), test(pos) and next(pos),
+// on cold and warm segbitsets of various sizes, to validate changes to __find and __pushup_to_root.
+//
+// Calls are timed in batches of a few calls on the time stamp counter (rdtsc, fenced) to amortize the timer
+// overhead, and each batch yields a sample of its average latency per call. The counter is calibrated against
+// std::chrono::steady_clock. Off x86, std::chrono::steady_clock times the batches instead.
+//   warm: positions are drawn from a pool of 256 positions, so that their paths stay in cache.
+//   cold: positions are fresh random ones, and the segbitset is flushed from cache (clflush) before each
+//         batch. Sets larger than 1MB (above 2M bits) aren't flushed, since flushing them costs far more
+//         than the calls, random positions on them miss the inner caches but for the top levels, and miss
+//         the last level cache once the set outgrows it, e.g. at 1G bits. Cold runs are x86 only.
+// Each batch of set(pos) is followed by a batch of reset(pos) on the same positions, keeping the density
+// at the pre-filled 2%.
+//
+// Results are printed as a tab-separated table, one row per (n, mode, op), with percentiles in nanoseconds.
+//
+// Usage: segbitset_latency_benchmark [max_n] [batch]
+//   max_n limits the sizes, defaults to 16M, pass 1G to include 1G bits. batch defaults to 8 calls.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define SEGBITSET_BENCHMARK_X86
+#endif
+
+#include "segbitset.h"
+
+static std::mt19937_64 rng(std::random_device{}());
+static volatile std::size_t sink;  // avoid compiler optimization away
+
+static const std::size_t WARM_SAMPLES = 100000, COLD_SAMPLES = 5000, WARM_POOL = 256;
+static const std::size_t MAX_FLUSH_BYTES = 1 << 20;
+static std::size_t BATCH = 8;
+
+////////////////////////////////////////
+/// Timer
+////////////////////////////////////////
+
+#ifdef SEGBITSET_BENCHMARK_X86
+static inline uint64_t ticks() {
+  _mm_lfence();
+  auto t = __rdtsc();
+  _mm_lfence();
+  return t;
+}
+#else
+static inline uint64_t ticks() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+#endif
+
+// returns nanoseconds per tick.
+static double calibrate() {
+  auto t0 = ticks();
+  auto c0 = std::chrono::steady_clock::now();
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  auto t1 = ticks();
+  auto c1 = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(c1 - c0).count() / double(t1 - t0);
+}
+
+static const double NS_PER_TICK = calibrate();
+
+// flushes the bytes of a from all cache levels.
+template <typename T>
+void flush(const T& a) {
+#ifdef SEGBITSET_BENCHMARK_X86
+  if (sizeof(T) > MAX_FLUSH_BYTES) return;
+  auto p = reinterpret_cast<const char*>(&a);
+  for (std::size_t i = 0; i < sizeof(T); i += 64) _mm_clflush(p + i);
+  _mm_mfence();
+#endif
+}
+
+////////////////////////////////////////
+/// Benchmark
+////////////////////////////////////////
+
+static void report(std::size_t n, const char* mode, const char* op, std::vector<double>& ns) {
+  std::sort(ns.begin(), ns.end());
+  auto p = [&](double q) { return ns[std::min(ns.size() - 1, std::size_t(q * ns.size()))]; };
+  std::printf("%zu\t%s\t%s\t%zu\t%zu\t%.1f\t%.1f\t%.1f\t%.1f\n", n, mode, op, BATCH, ns.size(), p(0.5),
+              p(0.99), p(0.999), ns.back());
+  std::fflush(stdout);
+}
+
+template <std::size_t N>
+void benchmark(std::size_t max_n, bool cold) {
+  if (N > max_n) return;
+  using S = segbitset::segbitset<N>;
+  std::uniform_int_distribution<std::size_t> distribution(0, N - 1);
+  auto s = std::make_unique<S>();
+  for (std::size_t i = 0; i < N / 50; i++) s->set(distribution(rng));
+
+  std::vector<std::size_t> pool(WARM_POOL);
+  for (auto& pos : pool) pos = distribution(rng);
+  std::uniform_int_distribution<std::size_t> from_pool(0, WARM_POOL - 1);
+
+  const char* ops[] = {"set", "reset", "test", "next"};
+  std::vector<std::vector<double>> ns(4);
+  std::vector<std::size_t> positions(BATCH);
+  std::vector<bool> was(BATCH);
+  auto samples = cold ? COLD_SAMPLES : WARM_SAMPLES;
+
+  // times a batch of calls of op k on positions.
+  auto time = [&](std::size_t k, auto&& call) {
+    if (cold) flush(*s);
+    auto t0 = ticks();
+    for (std::size_t i = 0; i < BATCH; i++) call(positions[i]);
+    auto t1 = ticks();
+    ns[k].push_back((t1 - t0) * NS_PER_TICK / BATCH);
+  };
+
+  for (std::size_t round = 0; round < samples + (cold ? 0 : 100); round++) {  // first 100 warm rounds warm up
+    for (std::size_t i = 0; i < BATCH; i++) {
+      positions[i] = cold ? distribution(rng) : pool[from_pool(rng)];
+      was[i] = s->test(positions[i]);
+    }
+    time(0, [&](std::size_t pos) { s->set(pos); });
+    time(1, [&](std::size_t pos) { s->reset(pos); });
+    for (std::size_t i = 0; i < BATCH; i++)  // restores
+      if (was[i]) s->set(positions[i]);
+    time(2, [&](std::size_t pos) { sink = s->test(pos); });
+    time(3, [&](std::size_t pos) { sink = s->next(pos); });
+    if (!cold && round == 99)
+      for (auto& v : ns) v.clear();
+  }
+  for (std::size_t k = 0; k < 4; k++) report(N, cold ? "cold" : "warm", ops[k], ns[k]);
+}
+
+template <std::size_t N>
+void benchmark(std::size_t max_n) {
+  benchmark<N>(max_n, false);
+#ifdef SEGBITSET_BENCHMARK_X86
+  benchmark<N>(max_n, true);
+#endif
+}
+
+int main(int argc, char* argv[]) {
+  std::size_t max_n = 16 << 20;
+  if (argc > 1) {
+    std::string s = argv[1];
+    max_n = std::strtoull(s.c_str(), nullptr, 10);
+    if (s.back() == 'K') max_n <<= 10;
+    if (s.back() == 'M') max_n <<= 20;
+    if (s.back() == 'G') max_n <<= 30;
+  }
+  if (argc > 2) BATCH = std::max<std::size_t>(1, std::strtoull(argv[2], nullptr, 10));
+
+  std::printf("n\tmode\top\tbatch\tsamples\tp50_ns\tp99_ns\tp999_ns\tmax_ns\n");
+  benchmark<1 << 10>(max_n);
+  benchmark<1 << 16>(max_n);
+  benchmark<1 << 20>(max_n);
+  benchmark<16 << 20>(max_n);
+  benchmark<1 << 30>(max_n);
+  return 0;
+}
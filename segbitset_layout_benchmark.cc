@@ -0,0 +1,96 @@
+// Benchmarks on tree node layouts: heap order (word_bitset) vs van Emde Boas order (veb_bitset).
+// The counters test cases print hardware counters per position accessed (see segbitset_perf.h), to tell
+// whether a layout saves cache or TLB misses.
+
+#include <catch2/benchmark/catch_benchmark_all.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "segbitset.h"
+#include "segbitset_perf.h"
+
+static const std::size_t N_100K_BITS = 100000;
+static const std::size_t N_1G_BITS = 1024 * 1024 * 1024;
+static std::mt19937 rng(std::random_device{}());
+
+template <std::size_t N, template <std::size_t> class Storage>
+void benchmark_layout(const std::string& label) {
+  using S = segbitset::segbitset<N, Storage>;
+  // about 1/50 bits (about 2%) are set.
+  std::uniform_int_distribution<std::size_t> distribution(0, N - 1);
+  auto s = std::make_unique<S>();
+  for (std::size_t i = 0; i < N / 50; i++) s->set(distribution(rng));
+  std::vector<std::size_t> positions(1 << 16);
+  for (auto& pos : positions) pos = distribution(rng);
+
+  std::size_t cnt = 0;  // avoid compiler optimization away
+
+  BENCHMARK(label + " - test 64K random positions") {
+    for (auto pos : positions) cnt += s->test(pos);
+  };
+  BENCHMARK(label + " - set 64K random positions") {
+    for (auto pos : positions) s->set(pos, s->test(pos));  // keeps s unchanged
+  };
+  BENCHMARK(label + " - next of 64K random positions") {
+    for (auto pos : positions) cnt += s->next(pos);
+  };
+}
+
+// prints hardware counters per position of the same operations as benchmark_layout.
+template <std::size_t N, template <std::size_t> class Storage>
+void count_layout(const std::string& label) {
+  using S = segbitset::segbitset<N, Storage>;
+  segbitset::perf::counters counters;
+  if (!counters.available()) {
+    WARN("hardware counters are unavailable, skipped " << label);
+    return;
+  }
+  std::uniform_int_distribution<std::size_t> distribution(0, N - 1);
+  auto s = std::make_unique<S>();
+  for (std::size_t i = 0; i < N / 50; i++) s->set(distribution(rng));
+  std::vector<std::size_t> positions(1 << 16);
+  for (auto& pos : positions) pos = distribution(rng);
+
+  std::size_t cnt = 0;  // avoid compiler optimization away
+  auto report = [&](const char* op, auto&& f) {
+    f();  // warms up
+    counters.start();
+    f();
+    auto sample = counters.stop() / positions.size();
+    std::printf("%s - %s:", label.c_str(), op);
+    for (auto e : segbitset::perf::all)
+      if (counters.available(e)) std::printf(" %s=%.2f", segbitset::perf::name(e), sample[e]);
+    std::printf(" (per position)\n");
+  };
+  report("test 64K random positions", [&] {
+    for (auto pos : positions) cnt += s->test(pos);
+  });
+  report("set 64K random positions", [&] {
+    for (auto pos : positions) s->set(pos, s->test(pos));  // keeps s unchanged
+  });
+  report("next of 64K random positions", [&] {
+    for (auto pos : positions) cnt += s->next(pos);
+  });
+  REQUIRE(cnt > 0);
+}
+
+TEST_CASE("benchmark/layout/100K", "heap vs van Emde Boas layout, 100K bits") {
+  benchmark_layout<N_100K_BITS, segbitset::word_bitset>("heap - 100K");
+  benchmark_layout<N_100K_BITS, segbitset::veb_bitset>("veb - 100K");
+}
+
+TEST_CASE("benchmark/layout/1G", "heap vs van Emde Boas layout, 1G bits") {
+  benchmark_layout<N_1G_BITS, segbitset::word_bitset>("heap - 1G");
+  benchmark_layout<N_1G_BITS, segbitset::veb_bitset>("veb - 1G");
+}
+
+TEST_CASE("benchmark/layout/counters", "hardware counters of heap vs van Emde Boas layout") {
+  count_layout<N_100K_BITS, segbitset::word_bitset>("heap - 100K");
+  count_layout<N_100K_BITS, segbitset::veb_bitset>("veb - 100K");
+  count_layout<N_1G_BITS, segbitset::word_bitset>("heap - 1G");
+  count_layout<N_1G_BITS, segbitset::veb_bitset>("veb - 1G");
+}
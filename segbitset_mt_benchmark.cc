@@ -0,0 +1,188 @@
+// Benchmark on concurrent use: throughput of mixed set/test/pop_first/next workloads over 1 to 64 threads,
+// for concurrent_segbitset (lock-free) against a segbitset guarded by a std::mutex.
+//
+// Each thread runs the workload for a fixed duration, a write_ratio of the calls are writes (set, or pop of
+// the first true bit at or after the position, wrapping around within the locality), the others are reads
+// (half test, half next). Positions are drawn by locality:
+//   subtree: all threads hit the same 4096 bits, i.e. the same subtree, contending on its summaries.
+//   spread:  all threads hit positions spread over the whole set.
+//   first:   like spread, but pops are pop_first(), all threads claiming the first true bit of the whole set,
+//            contending on the root-to-leaf path to it.
+// The set is pre-filled to 10% of the positions of the locality, and sets and pops are weighted to keep it
+// there: a set adds a bit only if it's false, a pop removes one whenever the locality isn't empty.
+//
+// Results are printed as a tab-separated table, one row per (impl, locality, write_ratio, threads), with the
+// throughput in calls per second, and the scaling against a single thread of the same workload.
+// Scaling is bounded by the number of cores of the host, threads beyond are time-sliced.
+//
+// Usage: segbitset_mt_benchmark [duration_ms] [max_threads]
+//   duration_ms defaults to 200, max_threads defaults to 64.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "segbitset.h"
+#include "segbitset_concurrent.h"
+
+static const std::size_t N = 1 << 20;
+static const std::size_t SUBTREE = 4096;
+static const std::vector<double> WRITE_RATIOS = {0, 0.1, 0.5, 0.9};
+// sets out of 1024 writes, balancing the pops at 10% density: sets * 0.9 == 1024 - sets.
+static const uint64_t SETS = 539;
+
+// returns the first true bit of s at or after pos in [first, last), wrapping around to first, N if none.
+template <typename S>
+std::size_t find_in(const S& s, std::size_t first, std::size_t last, std::size_t pos) {
+  auto ans = pos ? s.next(pos - 1) : s.first();
+  if (ans >= last) ans = first ? s.next(first - 1) : s.first();
+  return ans < last ? ans : N;
+}
+
+////////////////////////////////////////
+/// Implementations under test
+////////////////////////////////////////
+
+struct lockfree {
+  using S = segbitset::concurrent_segbitset<N>;
+  static constexpr const char* name = "lockfree";
+  std::unique_ptr<S> s = std::make_unique<S>();
+
+  void set(std::size_t pos) { s->set(pos); }
+  bool test(std::size_t pos) { return s->test(pos); }
+  std::size_t next(std::size_t pos) { return s->next(pos); }
+  std::size_t pop_first() { return s->pop_first(); }
+  // pops the first true bit at or after pos in [first, last), wrapping around, N if none.
+  std::size_t pop(std::size_t first, std::size_t last, std::size_t pos) {
+    for (auto ans = find_in(*s, first, last, pos); ans < N; ans = find_in(*s, first, last, ans))
+      if (s->try_reset(ans)) return ans;  // otherwise claimed by another thread, retries.
+    return N;
+  }
+};
+
+struct mutex {
+  static constexpr const char* name = "mutex";
+  std::unique_ptr<segbitset::segbitset<N>> s = std::make_unique<segbitset::segbitset<N>>();
+  std::mutex mu;
+
+  void set(std::size_t pos) {
+    std::lock_guard lock(mu);
+    s->set(pos);
+  }
+  bool test(std::size_t pos) {
+    std::lock_guard lock(mu);
+    return s->test(pos);
+  }
+  std::size_t next(std::size_t pos) {
+    std::lock_guard lock(mu);
+    return s->next(pos);
+  }
+  std::size_t pop_first() {
+    std::lock_guard lock(mu);
+    return s->pop_first();
+  }
+  std::size_t pop(std::size_t first, std::size_t last, std::size_t pos) {
+    std::lock_guard lock(mu);
+    auto ans = find_in(*s, first, last, pos);
+    if (ans < N) s->reset(ans);
+    return ans;
+  }
+};
+
+////////////////////////////////////////
+/// Workload
+////////////////////////////////////////
+
+// xorshift64, cheaper than std::mt19937 so that the workload is dominated by the set.
+struct xorshift {
+  uint64_t x;
+  uint64_t operator()() {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return x;
+  }
+};
+
+struct alignas(64) counter {
+  std::size_t ops = 0;
+};
+
+// returns the throughput in calls per second.
+template <typename Impl>
+double run(const std::string& locality, double write_ratio, std::size_t threads,
+           std::chrono::milliseconds duration) {
+  Impl impl;
+  const bool subtree = locality == "subtree", first = locality == "first";
+  const std::size_t base = subtree ? (N - SUBTREE) / 2 : 0, span = subtree ? SUBTREE : N;
+  xorshift fill{0x9E3779B97F4A7C15};
+  for (std::size_t i = 0; i < span / 10; i++) impl.set(base + fill() % span);
+
+  const auto writes = uint64_t(write_ratio * (1 << 16));
+  std::atomic<bool> start{false}, stop{false};
+  std::vector<counter> counters(threads);
+  std::vector<std::thread> workers;
+  std::atomic<std::size_t> sink{0};  // avoid compiler optimization away
+  for (std::size_t t = 0; t < threads; t++) {
+    workers.emplace_back([&, t] {
+      xorshift rng{(t + 1) * 0x2545F4914F6CDD1D};
+      std::size_t ops = 0, acc = 0;
+      while (!start.load(std::memory_order_acquire)) std::this_thread::yield();
+      while (!stop.load(std::memory_order_relaxed)) {
+        for (int i = 0; i < 64; i++, ops++) {
+          auto r = rng();
+          auto pos = base + (r >> 20) % span;
+          bool write = (r & 0xffff) < writes, half = r & 0x10000;
+          if (write)
+            (r >> 54) < SETS ? impl.set(pos)
+                             : (void)(acc += first ? impl.pop_first() : impl.pop(base, base + span, pos));
+          else
+            acc += half ? impl.test(pos) : impl.next(pos);
+        }
+      }
+      counters[t].ops = ops;
+      sink += acc;
+    });
+  }
+  auto begin = std::chrono::steady_clock::now();
+  start.store(true, std::memory_order_release);
+  std::this_thread::sleep_for(duration);
+  stop.store(true);
+  for (auto& w : workers) w.join();
+  auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+  std::size_t ops = 0;
+  for (auto& c : counters) ops += c.ops;
+  return ops / elapsed;
+}
+
+template <typename Impl>
+void sweep(std::size_t max_threads, std::chrono::milliseconds duration) {
+  for (std::string locality : {"subtree", "spread", "first"}) {
+    for (auto write_ratio : WRITE_RATIOS) {
+      double single = 0;
+      for (std::size_t threads = 1; threads <= max_threads; threads <<= 1) {
+        auto throughput = run<Impl>(locality, write_ratio, threads, duration);
+        if (threads == 1) single = throughput;
+        std::printf("%s\t%s\t%.2f\t%zu\t%.0f\t%.2f\n", Impl::name, locality.c_str(),
+                    write_ratio, threads, throughput, throughput / single);
+        std::fflush(stdout);
+      }
+    }
+  }
+}
+
+int main(int argc, char* argv[]) {
+  std::chrono::milliseconds duration(argc > 1 ? std::atol(argv[1]) : 200);
+  std::size_t max_threads = argc > 2 ? std::atol(argv[2]) : 64;
+  std::printf("impl\tlocality\twrite_ratio\tthreads\tcalls_per_sec\tscaling\n");
+  sweep<lockfree>(max_threads, duration);
+  sweep<mutex>(max_threads, duration);
+  return 0;
+}
@@ -0,0 +1,175 @@
+// Copyright (c) 2024 Chao Wang <hit9@icloud.com>.
+// License: BSD. https://github.com/hit9/segbitset
+// Hardware performance counters for segbitset benchmarks, via Linux perf_event_open.
+//
+// Wall time doesn't tell whether a change reduced cache misses or branch mispredicts, these counters do.
+// Events are opened one by one, so a host lacking some of them (e.g. VMs often lack the cache events)
+// still counts the others. When the kernel multiplexes events, counts are scaled by the time each event was
+// actually counting. Unavailable events read as NaN, and nothing is available off Linux, or when
+// /proc/sys/kernel/perf_event_paranoid is above 2 (only user space is counted, so 2 is enough).
+//
+// Usage:
+//   segbitset::perf::counters counters;
+//   counters.start();
+//   op();
+//   auto sample = counters.stop();  // sample[segbitset::perf::event::cycles], NaN if unavailable
+
+#ifndef __HIT9_SEGBITSET_PERF
+#define __HIT9_SEGBITSET_PERF
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace segbitset {
+namespace perf {
+
+using size_t = std::size_t;
+
+enum class event { cycles, instructions, l1d_misses, llc_misses, branch_misses, dtlb_misses };
+
+// all events, to iterate over.
+inline constexpr event all[] = {event::cycles,     event::instructions,  event::l1d_misses,
+                                event::llc_misses, event::branch_misses, event::dtlb_misses};
+inline constexpr size_t N_EVENTS = sizeof(all) / sizeof(all[0]);
+
+// returns the name of given event.
+constexpr const char* name(event e) {
+  switch (e) {
+    case event::cycles:
+      return "cycles";
+    case event::instructions:
+      return "instructions";
+    case event::l1d_misses:
+      return "l1d_misses";
+    case event::llc_misses:
+      return "llc_misses";
+    case event::branch_misses:
+      return "branch_misses";
+    case event::dtlb_misses:
+      return "dtlb_misses";
+  }
+  return "";
+}
+
+// sample holds a count per event, NaN for unavailable events.
+struct sample {
+  double values[N_EVENTS] = {NAN, NAN, NAN, NAN, NAN, NAN};
+
+  double operator[](event e) const { return values[static_cast<size_t>(e)]; }
+  // divides all counts by d, e.g. to normalize per call, per bit or per set bit.
+  sample operator/(double d) const {
+    sample s = *this;
+    for (auto& v : s.values) v /= d;
+    return s;
+  }
+};
+
+// counters counts the events of the calling thread, between start() and stop().
+class counters {
+ public:
+  counters() noexcept {
+    for (size_t i = 0; i < N_EVENTS; i++) fds[i] = __open(all[i]);
+  }
+  ~counters() {
+#if defined(__linux__)
+    for (auto fd : fds)
+      if (fd >= 0) close(fd);
+#endif
+  }
+  counters(const counters&) = delete;
+  counters& operator=(const counters&) = delete;
+
+  // returns true if given event is counted.
+  bool available(event e) const noexcept { return fds[static_cast<size_t>(e)] >= 0; }
+  // returns true if any event is counted.
+  bool available() const noexcept {
+    for (auto e : all)
+      if (available(e)) return true;
+    return false;
+  }
+  // resets and starts counting.
+  void start() noexcept {
+#if defined(__linux__)
+    for (auto fd : fds) {
+      if (fd < 0) continue;
+      ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+  }
+  // stops counting, returns the counts since start().
+  sample stop() noexcept {
+    sample s;
+#if defined(__linux__)
+    for (auto fd : fds)
+      if (fd >= 0) ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    for (size_t i = 0; i < N_EVENTS; i++) {
+      uint64_t v[3];  // value, time enabled, time running
+      if (fds[i] < 0 || read(fds[i], v, sizeof(v)) != sizeof(v) || !v[2]) continue;
+      s.values[i] = double(v[0]) * v[1] / v[2];
+    }
+#endif
+    return s;
+  }
+
+ private:
+  int fds[N_EVENTS];
+
+  // opens given event for the calling thread on any cpu, returns -1 if unavailable.
+  static int __open(event e) noexcept {
+#if defined(__linux__)
+    auto cache = [](uint64_t id) {
+      return id | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    };
+    perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    switch (e) {
+      case event::cycles:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CPU_CYCLES;
+        break;
+      case event::instructions:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+        break;
+      case event::l1d_misses:
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = cache(PERF_COUNT_HW_CACHE_L1D);
+        break;
+      case event::llc_misses:
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = cache(PERF_COUNT_HW_CACHE_LL);
+        break;
+      case event::branch_misses:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+        break;
+      case event::dtlb_misses:
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = cache(PERF_COUNT_HW_CACHE_DTLB);
+        break;
+    }
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#else
+    (void)e;
+    return -1;
+#endif
+  }
+};
+
+}  // namespace perf
+}  // namespace segbitset
+
+#endif
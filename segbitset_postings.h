@@ -0,0 +1,223 @@
+// Copyright (c) 2024 Chao Wang <hit9@icloud.com>.
+// License: BSD. https://github.com/hit9/segbitset
+// An inverted index of terms to the segbitsets of their documents, for conjunctive and disjunctive queries.
+//
+// Each term keeps its postings as a segbitset<N> of document ids, with its cardinality cached on updates.
+// A query is planned before it runs:
+//
+//   all_of(terms): empty at once if any term has no postings, which the root summary of a segbitset tells
+//     in O(1), otherwise the postings are ordered by cardinality, smallest first, and estimated to cost
+//     the smallest cardinality times the number of terms.
+//   any_of(terms): terms without postings are dropped, and the estimated cost is the sum of cardinalities.
+//
+// Plans run without materializing any set: all_of leapfrogs, the smallest postings proposing candidates by
+// next(), and the others either accepting or skipping ahead to their next document at or after it, every
+// next() skipping empty subtrees. any_of merges the postings on a heap of their next documents. Documents
+// come in increasing order, so top(k) returns the first k, e.g. of ids assigned by static rank.
+//
+// Usage:
+//   segbitset::posting_index<1 << 20> index;
+//   index.add("fast", 3), index.add("bitset", 3);
+//   auto plan = index.all_of({"fast", "bitset"});
+//   auto docs = plan.top(10);
+//   plan.foreach([](size_t doc) { ...; return true; });  // return false to stop
+
+#ifndef __HIT9_SEGBITSET_POSTINGS
+#define __HIT9_SEGBITSET_POSTINGS
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "segbitset.h"
+
+namespace segbitset {
+
+template <size_t N>
+class posting_index {
+ public:
+  using bitset_type = segbitset<N>;
+
+  // a planned conjunctive or disjunctive query, valid until the index is changed.
+  class plan {
+   public:
+    // returns true if no document matches, known at planning.
+    bool empty() const noexcept { return lists.empty(); }
+    // returns the estimated number of segbitset walks to run this plan.
+    size_t estimated_cost() const noexcept { return cost; }
+    // calls cb(doc) for each matching document in increasing order. cb may return a bool, false to stop.
+    template <typename Callback>
+    void foreach(Callback&& cb) const;
+    // returns the first k matching documents.
+    std::vector<size_t> top(size_t k) const;
+
+   private:
+    friend class posting_index;
+    bool conjunctive = true;
+    std::vector<const bitset_type*> lists;  // postings to combine, smallest first for a conjunction
+    size_t cost = 0;
+
+    // returns the first document of s at or after pos, N if not found.
+    static size_t __seek(const bitset_type& s, size_t pos) noexcept {
+      if (pos >= N) return N;
+      return pos ? s.next(pos - 1) : s.first();
+    }
+    template <typename Callback>
+    void __leapfrog(Callback&& emit) const;
+    template <typename Callback>
+    void __merge(Callback&& emit) const;
+  };
+
+  // adds doc to the postings of term, returns false if already there.
+  // throws std::out_of_range if doc is invalid.
+  bool add(const std::string& term, size_t doc);
+  // removes doc from the postings of term, returns false if not there.
+  bool remove(const std::string& term, size_t doc);
+  // returns the number of documents of term, O(1).
+  size_t cardinality(const std::string& term) const noexcept;
+  // returns the postings of term, nullptr if the term is unknown.
+  const bitset_type* postings(const std::string& term) const noexcept;
+
+  // plans a query of the documents having all the terms.
+  plan all_of(const std::vector<std::string>& terms) const;
+  // plans a query of the documents having any of the terms.
+  plan any_of(const std::vector<std::string>& terms) const;
+
+ private:
+  struct __term {
+    std::unique_ptr<bitset_type> docs = std::make_unique<bitset_type>();
+    size_t count = 0;  // cached cardinality
+  };
+  std::unordered_map<std::string, __term> terms;
+};
+
+template <size_t N>
+bool posting_index<N>::add(const std::string& term, size_t doc) {
+  if (doc >= N) throw std::out_of_range("posting_index::add doc >= N");
+  auto& t = terms[term];
+  if (t.docs->test(doc)) return false;
+  t.docs->set(doc), t.count++;
+  return true;
+}
+
+template <size_t N>
+bool posting_index<N>::remove(const std::string& term, size_t doc) {
+  auto it = terms.find(term);
+  if (it == terms.end() || doc >= N || !it->second.docs->test(doc)) return false;
+  it->second.docs->reset(doc), it->second.count--;
+  return true;
+}
+
+template <size_t N>
+size_t posting_index<N>::cardinality(const std::string& term) const noexcept {
+  auto it = terms.find(term);
+  return it == terms.end() ? 0 : it->second.count;
+}
+
+template <size_t N>
+const typename posting_index<N>::bitset_type* posting_index<N>::postings(
+    const std::string& term) const noexcept {
+  auto it = terms.find(term);
+  return it == terms.end() ? nullptr : it->second.docs.get();
+}
+
+template <size_t N>
+typename posting_index<N>::plan posting_index<N>::all_of(const std::vector<std::string>& terms) const {
+  plan p;
+  std::vector<std::pair<size_t, const bitset_type*>> lists;
+  for (auto& term : terms) {
+    auto s = postings(term);
+    if (!s || s->none()) return p;  // a term without postings, nothing matches
+    lists.emplace_back(cardinality(term), s);
+  }
+  if (lists.empty()) return p;
+  std::sort(lists.begin(), lists.end(), [](auto& a, auto& b) { return a.first < b.first; });
+  for (auto& [count, s] : lists) p.lists.push_back(s);
+  p.cost = lists[0].first * lists.size();
+  return p;
+}
+
+template <size_t N>
+typename posting_index<N>::plan posting_index<N>::any_of(const std::vector<std::string>& terms) const {
+  plan p;
+  p.conjunctive = false;
+  for (auto& term : terms) {
+    auto s = postings(term);
+    if (!s || s->none() || std::find(p.lists.begin(), p.lists.end(), s) != p.lists.end()) continue;
+    p.lists.push_back(s);
+    p.cost += cardinality(term);
+  }
+  return p;
+}
+
+template <size_t N>
+template <typename Callback>
+void posting_index<N>::plan::__leapfrog(Callback&& emit) const {
+  auto& first = *lists[0];
+  for (auto pos = first.first(); pos < N;) {
+    auto candidate = pos;
+    for (size_t j = 1; j < lists.size() && pos == candidate; j++) pos = __seek(*lists[j], candidate);
+    if (pos == candidate) {  // accepted by all
+      if (!emit(pos)) return;
+      ++pos;
+    }
+    pos = __seek(first, pos);
+  }
+}
+
+template <size_t N>
+template <typename Callback>
+void posting_index<N>::plan::__merge(Callback&& emit) const {
+  // a min heap of (next document, postings).
+  using head = std::pair<size_t, const bitset_type*>;
+  std::priority_queue<head, std::vector<head>, std::greater<head>> heap;
+  for (auto s : lists) heap.emplace(s->first(), s);
+  while (!heap.empty()) {
+    auto pos = heap.top().first;
+    if (!emit(pos)) return;
+    while (!heap.empty() && heap.top().first == pos) {  // advances all the postings at pos
+      auto s = heap.top().second;
+      heap.pop();
+      if (auto next = s->next(pos); next < N) heap.emplace(next, s);
+    }
+  }
+}
+
+template <size_t N>
+template <typename Callback>
+void posting_index<N>::plan::foreach(Callback&& cb) const {
+  if (empty()) return;
+  auto emit = [&](size_t doc) {
+    if constexpr (std::is_same_v<std::invoke_result_t<Callback&, size_t>, bool>)
+      return cb(doc);
+    else
+      return cb(doc), true;
+  };
+  if (conjunctive)
+    __leapfrog(emit);
+  else
+    __merge(emit);
+}
+
+template <size_t N>
+std::vector<size_t> posting_index<N>::plan::top(size_t k) const {
+  std::vector<size_t> docs;
+  if (!k) return docs;
+  foreach([&](size_t doc) {
+    docs.push_back(doc);
+    return docs.size() < k;
+  });
+  return docs;
+}
+
+}  // namespace segbitset
+
+#endif
@@ -0,0 +1,66 @@
+#include "segbitset_postings.h"
+
+#include <algorithm>
+#include <catch2/catch_test_macros.hpp>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+static std::mt19937 rng(std::random_device{}());
+
+TEST_CASE("posting_index", "[queries - compare to std::set]") {
+  const std::size_t N = 5000;
+  segbitset::posting_index<N> index;
+  std::vector<std::string> terms{"a", "b", "c", "d", "rare"};
+  std::vector<std::set<std::size_t>> e(terms.size());
+  std::uniform_int_distribution<std::size_t> docs(0, N - 1);
+  for (std::size_t t = 0; t < terms.size(); t++) {
+    // "a" is the densest, "rare" has a few documents only.
+    std::size_t n = t + 1 == terms.size() ? 5 : N / (t + 2);
+    for (std::size_t i = 0; i < n; i++) {
+      auto doc = docs(rng);
+      REQUIRE(index.add(terms[t], doc) == e[t].insert(doc).second);
+    }
+    for (std::size_t i = 0; i < n / 10; i++) {
+      auto doc = docs(rng);
+      REQUIRE(index.remove(terms[t], doc) == (e[t].erase(doc) > 0));
+    }
+    REQUIRE(index.cardinality(terms[t]) == e[t].size());
+  }
+  auto expected = [&](const std::vector<std::size_t>& query, bool conjunctive) {
+    std::vector<std::size_t> ans;
+    for (std::size_t doc = 0; doc < N; doc++) {
+      std::size_t n = 0;
+      for (auto t : query) n += e[t].count(doc);
+      if (conjunctive ? n == query.size() : n > 0) ans.push_back(doc);
+    }
+    return ans;
+  };
+  for (auto query : std::vector<std::vector<std::size_t>>{{0}, {0, 1}, {2, 1, 0}, {3, 4, 0}, {0, 1, 2, 3}}) {
+    std::vector<std::string> names;
+    for (auto t : query) names.push_back(terms[t]);
+    for (bool conjunctive : {true, false}) {
+      auto plan = conjunctive ? index.all_of(names) : index.any_of(names);
+      std::vector<std::size_t> docs;
+      plan.foreach([&](std::size_t doc) { docs.push_back(doc); });
+      auto want = expected(query, conjunctive);
+      REQUIRE(docs == want);
+      if (plan.empty()) REQUIRE(want.empty());  // may be unknown at planning
+      want.resize(std::min<std::size_t>(want.size(), 7));
+      REQUIRE(plan.top(7) == want);
+    }
+  }
+  // the smallest postings drive a conjunction.
+  REQUIRE(index.all_of({"a", "rare"}).estimated_cost() == 2 * index.cardinality("rare"));
+  REQUIRE(index.any_of({"a", "rare"}).estimated_cost() == index.cardinality("a") + index.cardinality("rare"));
+  // unknown or empty terms.
+  REQUIRE(index.all_of({"a", "unknown"}).empty());
+  REQUIRE(index.all_of({}).empty());
+  REQUIRE(index.any_of({"unknown"}).top(3).empty());
+  REQUIRE(index.any_of({"a", "unknown"}).top(3) == index.all_of({"a"}).top(3));
+  REQUIRE(index.postings("unknown") == nullptr);
+  REQUIRE(!index.remove("unknown", 1));
+  REQUIRE_THROWS_AS(index.add("a", N), std::out_of_range);
+}
@@ -0,0 +1,67 @@
+// Benchmarks on datasets larger than the last level cache, to see how prefetching hides the latency.
+// This file is built twice: segbitset_prefetch_benchmark without prefetching,
+// segbitset_prefetch_benchmark_on with SEGBITSET_PREFETCH_DISTANCE defined.
+
+#include <catch2/benchmark/catch_benchmark_all.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "segbitset.h"
+
+static const std::string PREFETCH =
+    "prefetch distance " + std::to_string(SEGBITSET_PREFETCH_DISTANCE);  // 0 for no prefetching
+
+static const std::size_t N_1G_BITS = 1024 * 1024 * 1024;  // a tree of 512MB
+static std::mt19937 rng(std::random_device{}());
+
+template <std::size_t N>
+void benchmark_large(const std::string& label, std::size_t density) {
+  using S = segbitset::segbitset<N>;
+  // about 1/density bits are set on both operands.
+  std::uniform_int_distribution<std::size_t> distribution(0, N - 1);
+  auto s1 = std::make_unique<S>(), s2 = std::make_unique<S>();
+  for (std::size_t i = 0; i < N / density; i++) s1->set(distribution(rng));
+  for (std::size_t i = 0; i < N / density; i++) s2->set(distribution(rng));
+  std::vector<std::size_t> positions(1 << 20);
+  for (auto& pos : positions) pos = distribution(rng);
+
+  // the trees are too large to copy ahead for each run, so the mutating ops copy s1 to scratch first, and
+  // the time of "copy" is to subtract.
+  auto scratch = std::make_unique<S>();
+
+  auto name = [&](const std::string& op) { return PREFETCH + " - " + label + " - " + op; };
+
+  std::size_t cnt = 0;  // avoid compiler optimization away
+
+  BENCHMARK(name("test 1M random positions")) {
+    for (auto pos : positions) cnt += s1->test(pos);
+  };
+  BENCHMARK(name("set 1M random positions")) {
+    for (auto pos : positions) s2->set(pos, s2->test(pos));  // keeps s2 unchanged
+  };
+  BENCHMARK(name("first and next")) {
+    for (std::size_t pos = s1->first(); pos != N; pos = s1->next(pos)) ++cnt;
+  };
+  BENCHMARK(name("foreach1")) { s1->foreach1([&](std::size_t) { ++cnt; }); };
+  BENCHMARK(name("count")) { return s1->count(); };
+  BENCHMARK(name("copy")) { *scratch = *s1; };
+  BENCHMARK(name("|=")) {
+    *scratch = *s1;
+    *scratch |= *s2;
+  };
+  BENCHMARK(name("&=")) {
+    *scratch = *s1;
+    *scratch &= *s2;
+  };
+}
+
+TEST_CASE("benchmark/prefetch/1G/sparse", "1G bits, about 0.1% bits set") {
+  benchmark_large<N_1G_BITS>("1G - 0.1%", 1000);
+}
+
+TEST_CASE("benchmark/prefetch/1G/dense", "1G bits, about 2% bits set") {
+  benchmark_large<N_1G_BITS>("1G - 2%", 50);
+}
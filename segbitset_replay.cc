@@ -0,0 +1,210 @@
+// Replays operation traces recorded by segbitset::trace::recorder (see segbitset_trace.h) against tree
+// node layouts, to benchmark segbitset on real access patterns.
+//
+// The traced size n is rounded up to the next power of 2 (at least 1K bits) to pick a compiled segbitset size
+// N. The padding bits in [n, N) are kept false, cleared outside of the timed region after set_all and
+// flip_all, and set around all() only, so that results match the traced run. Walks pruned by the summary
+// skip the padding, but set_all, reset_all and flip_all still walk all N bits, which is reported on stderr
+// if n != N.
+// The trace is loaded into memory before replaying, bulk operands are built outside of the timed region.
+// Each call is timed alone with std::chrono::steady_clock, so latencies include the clock overhead
+// (tens of nanoseconds), which matters for point operations.
+// Walk engines are build options, segbitset_replay_recursive and segbitset_replay_prefetch are the same
+// tool built with SEGBITSET_RECURSIVE_WALK and SEGBITSET_PREFETCH_DISTANCE=8.
+//
+// Results are printed as a tab-separated table, one row per (layout, op), with the number of calls,
+// throughput in calls per second, and latency percentiles in nanoseconds. The row of op "total" covers
+// all calls of the layout.
+//
+// Usage: segbitset_replay <trace> [layout ...]
+//   layouts are heap (word_bitset), veb (veb_bitset) and std (std::bitset), default to all.
+
+#include <algorithm>
+#include <bitset>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "segbitset.h"
+#include "segbitset_trace.h"
+
+using segbitset::trace::op;
+using segbitset::trace::record;
+
+static volatile std::size_t sink;  // avoid compiler optimization away
+
+static const std::size_t N_OPS = static_cast<std::size_t>(op::pop_first) + 1;
+
+template <std::size_t M>
+using std_bitset = std::bitset<M>;
+
+// prints a row of given latencies in nanoseconds, sorts them.
+static void report(const char* layout, const char* name, std::vector<double>& ns) {
+  if (ns.empty()) return;
+  std::sort(ns.begin(), ns.end());
+  double total = 0;
+  for (auto x : ns) total += x;
+  auto p = [&](double q) { return ns[std::min(ns.size() - 1, std::size_t(q * ns.size()))]; };
+  std::printf("%s\t%s\t%zu\t%.0f\t%.0f\t%.0f\t%.0f\t%.0f\t%.0f\n", layout, name, ns.size(),
+              total > 0 ? ns.size() * 1e9 / total : 0.0, p(0.5), p(0.9), p(0.99), p(0.999), ns.back());
+}
+
+template <std::size_t N, template <std::size_t> class Storage>
+void replay(const char* layout, std::size_t n, const std::vector<record>& records) {
+  using S = segbitset::segbitset<N, Storage>;
+  using clock = std::chrono::steady_clock;
+  auto s = std::make_unique<S>();
+  auto operand = std::make_unique<S>();
+  std::vector<std::vector<double>> ns(N_OPS);
+
+  // the padding bits in [n, N).
+  auto padded = n < N;
+  auto bits = std::make_unique<std::bitset<N>>();
+  for (auto pos = n; pos < N; pos++) bits->set(pos);
+  auto padding = std::make_unique<S>(*bits);
+
+  for (const auto& r : records) {
+    if (segbitset::trace::has_operand(r.o)) {
+      operand->reset();
+      for (auto pos : r.operand) operand->set(pos);
+    }
+    if (padded && r.o == op::all) *s |= *padding;  // all() of the traced bits
+    auto start = clock::now();
+    switch (r.o) {
+      case op::set:
+        s->set(r.pos);
+        break;
+      case op::reset:
+        s->reset(r.pos);
+        break;
+      case op::flip:
+        s->flip(r.pos);
+        break;
+      case op::test:
+        sink = s->test(r.pos);
+        break;
+      case op::next:
+        sink = s->next(r.pos);
+        break;
+      case op::first:
+        sink = s->first();
+        break;
+      case op::count:
+        sink = s->count();
+        break;
+      case op::any:
+        sink = s->any();
+        break;
+      case op::none:
+        sink = s->none();
+        break;
+      case op::all:
+        sink = s->all();
+        break;
+      case op::foreach1:
+        s->foreach1([](std::size_t pos) { sink = pos; });
+        break;
+      case op::set_all:
+        s->set();
+        break;
+      case op::reset_all:
+        s->reset();
+        break;
+      case op::flip_all:
+        s->flip();
+        break;
+      case op::and_assign:
+        *s &= *operand;
+        break;
+      case op::or_assign:
+        *s |= *operand;
+        break;
+      case op::xor_assign:
+        *s ^= *operand;
+        break;
+      case op::equal:
+        sink = *s == *operand;
+        break;
+      case op::pop_first:
+        sink = s->pop_first();
+        break;
+    }
+    ns[static_cast<std::size_t>(r.o)].push_back(
+        std::chrono::duration<double, std::nano>(clock::now() - start).count());
+    if (padded && (r.o == op::all || r.o == op::set_all || r.o == op::flip_all)) s->andnot(*padding);
+  }
+
+  std::vector<double> all;
+  for (std::size_t i = 0; i < N_OPS; i++) {
+    all.insert(all.end(), ns[i].begin(), ns[i].end());
+    report(layout, segbitset::trace::name(static_cast<op>(i)), ns[i]);
+  }
+  report(layout, "total", all);
+}
+
+// replays on the smallest size of power of 2 that is at least max(n, 1K).
+template <std::size_t N = 1024>
+void replay(const std::string& layout, std::size_t n, const std::vector<record>& records) {
+  if constexpr (N < (std::size_t(1) << 30)) {
+    if (n > N) return replay<N * 2>(layout, n, records);
+  } else if (n > N) {
+    std::fprintf(stderr, "traced size %zu is too large\n", n);
+    std::exit(1);
+  }
+  if (n != N)
+    std::fprintf(stderr,
+                 "%s: replaying %zu traced bits on segbitset<%zu>, set_all, reset_all and flip_all walk all "
+                 "%zu bits\n",
+                 layout.c_str(), n, N, N);
+  if (layout == "heap")
+    replay<N, segbitset::word_bitset>("heap", n, records);
+  else if (layout == "veb")
+    replay<N, segbitset::veb_bitset>("veb", n, records);
+  else
+    replay<N, std_bitset>("std", n, records);
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    std::fprintf(stderr, "usage: %s <trace> [layout ...]\n", argv[0]);
+    return 1;
+  }
+  std::vector<std::string> layouts(argv + 2, argv + argc);
+  if (layouts.empty()) layouts = {"heap", "veb", "std"};
+  for (const auto& layout : layouts) {
+    if (layout != "heap" && layout != "veb" && layout != "std") {
+      std::fprintf(stderr, "unknown layout %s\n", layout.c_str());
+      return 1;
+    }
+  }
+
+  std::size_t n;
+  std::vector<record> records;
+  try {
+    std::ifstream in(argv[1], std::ios::binary);
+    if (!in) {
+      std::fprintf(stderr, "can't open %s\n", argv[1]);
+      return 1;
+    }
+    segbitset::trace::reader reader(in);
+    n = reader.size();
+    for (record r; reader.read(r);) {
+      if (r.pos >= n || (!r.operand.empty() && r.operand.back() >= n))
+        throw std::runtime_error("position out of traced size");
+      records.push_back(r);
+    }
+  } catch (const std::exception& e) {
+    std::fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+
+  std::printf("layout\top\tcalls\tcalls_per_sec\tp50_ns\tp90_ns\tp99_ns\tp999_ns\tmax_ns\n");
+  for (const auto& layout : layouts) replay(layout, n, records);
+  return 0;
+}
@@ -0,0 +1,98 @@
+// Copyright (c) 2024 Chao Wang <hit9@icloud.com>.
+// License: BSD. https://github.com/hit9/segbitset
+// A scheduler of tasks by priority, on a lock-free ready-mask, for event loops.
+//
+// Tasks are identified by (priority, slot), priority 0 being the highest, and their ready flags are the bits
+// priority * Slots + slot of a concurrent_segbitset, so the first ready bit is a task of the highest ready
+// priority, found by first() on the summaries in O(logN):
+//
+//   mark_ready(priority, slot): sets the ready flag, lock-free, from any producer thread.
+//   dispatch(): finds the highest ready priority by first(), then its first ready slot after the last one
+//     dispatched on that priority by next(), wrapping around to the first ready slot, so slots of a
+//     priority take turns. The task is claimed by try_reset(), so a task made ready once is dispatched
+//     once even with racing consumers, which retry on losing.
+//
+// Like concurrent_segbitset, dispatch() is weakly consistent: it may miss tasks made ready concurrently,
+// which are dispatched by later calls.
+//
+// Usage:
+//   auto scheduler = std::make_unique<segbitset::priority_scheduler<4, 1024>>();
+//   scheduler->mark_ready(1, fd);           // from any thread
+//   for (size_t task; (task = scheduler->dispatch()) < scheduler->size();)
+//     run(scheduler->priority(task), scheduler->slot(task));
+
+#ifndef __HIT9_SEGBITSET_SCHEDULER
+#define __HIT9_SEGBITSET_SCHEDULER
+
+#include <atomic>
+#include <cstddef>
+#include <stdexcept>
+
+#include "segbitset_concurrent.h"
+
+namespace segbitset {
+
+template <size_t Priorities, size_t Slots>
+class priority_scheduler {
+  static_assert(Priorities > 0 && Slots > 0);
+  static constexpr size_t N = Priorities * Slots;
+
+ public:
+  priority_scheduler() noexcept = default;
+  priority_scheduler(const priority_scheduler&) = delete;
+  priority_scheduler& operator=(const priority_scheduler&) = delete;
+
+  // returns the number of tasks, that is Priorities * Slots, which dispatch() returns if none is ready.
+  constexpr size_t size() const noexcept { return N; }
+  // returns the priority of the task dispatched.
+  static constexpr size_t priority(size_t task) noexcept { return task / Slots; }
+  // returns the slot of the task dispatched.
+  static constexpr size_t slot(size_t task) noexcept { return task % Slots; }
+
+  // marks the task (priority, slot) ready, lock-free. Marking a ready task again does nothing.
+  // throws std::out_of_range if the priority or slot is invalid.
+  void mark_ready(size_t priority, size_t slot) { ready.set(__task(priority, slot)); }
+  // unmarks the task (priority, slot), returns true if it was ready and not dispatched yet.
+  // throws std::out_of_range if the priority or slot is invalid.
+  bool cancel(size_t priority, size_t slot) { return ready.try_reset(__task(priority, slot)); }
+  // returns true if the task (priority, slot) is ready.
+  // throws std::out_of_range if the priority or slot is invalid.
+  bool is_ready(size_t priority, size_t slot) const { return ready.test(__task(priority, slot)); }
+  // checks if any task is ready.
+  bool any() const noexcept { return ready.any(); }
+
+  // claims a ready task of the highest priority, round-robin over the slots of the priority, returns
+  // priority * Slots + slot, or size() if none is ready.
+  size_t dispatch() noexcept;
+
+ private:
+  concurrent_segbitset<N> ready;
+  std::atomic<size_t> turn[Priorities]{};  // the slot to dispatch from on each priority, next to the last one
+
+  static size_t __task(size_t priority, size_t slot) {
+    if (priority >= Priorities || slot >= Slots) throw std::out_of_range("priority_scheduler: invalid task");
+    return priority * Slots + slot;
+  }
+};
+
+template <size_t Priorities, size_t Slots>
+size_t priority_scheduler<Priorities, Slots>::dispatch() noexcept {
+  for (auto first = ready.first(); first < N; first = ready.first()) {
+    // first is the first ready slot of the highest ready priority.
+    auto p = priority(first), base = p * Slots;
+    // the first ready slot at or after the turn of the priority, wrapping around to first.
+    auto from = base + turn[p].load(std::memory_order_relaxed);
+    auto task = from <= first ? first : ready.next(from - 1);
+    if (task >= base + Slots) task = first;
+    if (ready.try_reset(task)) {
+      turn[p].store(slot(task) + 1, std::memory_order_relaxed);
+      return task;
+    }
+    // claimed by another consumer, or cancelled, retries.
+  }
+  return N;
+}
+
+}  // namespace segbitset
+
+#endif
@@ -0,0 +1,63 @@
+#include "segbitset_scheduler.h"
+
+#include <algorithm>
+#include <catch2/catch_test_macros.hpp>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+TEST_CASE("priority_scheduler", "[priorities and round-robin]") {
+  segbitset::priority_scheduler<3, 8> s;
+  REQUIRE(s.dispatch() == s.size());
+  s.mark_ready(2, 0);
+  s.mark_ready(1, 5);
+  s.mark_ready(1, 2);
+  s.mark_ready(1, 7);
+  REQUIRE(s.is_ready(1, 5));
+  std::vector<std::size_t> slots;
+  // priority 1 first, slots in turn from 0.
+  for (int i = 0; i < 2; i++) {
+    auto task = s.dispatch();
+    REQUIRE(s.priority(task) == 1);
+    slots.push_back(s.slot(task));
+  }
+  REQUIRE(slots == std::vector<std::size_t>{2, 5});
+  // slot 2 is ready again, but slot 7 takes its turn before it wraps around.
+  s.mark_ready(1, 2);
+  s.mark_ready(0, 3);
+  REQUIRE(s.dispatch() == 3);  // a higher priority
+  REQUIRE(s.slot(s.dispatch()) == 7);
+  REQUIRE(s.slot(s.dispatch()) == 2);
+  REQUIRE(s.cancel(2, 0));
+  REQUIRE(!s.cancel(2, 0));
+  REQUIRE(!s.any());
+  REQUIRE(s.dispatch() == s.size());
+  REQUIRE_THROWS_AS(s.mark_ready(3, 0), std::out_of_range);
+  REQUIRE_THROWS_AS(s.mark_ready(0, 8), std::out_of_range);
+}
+
+TEST_CASE("priority_scheduler", "[multiple producers and consumers - each task is dispatched once]") {
+  const std::size_t P = 4, S = 5000, T = 4;
+  auto s = std::make_unique<segbitset::priority_scheduler<P, S>>();
+  std::vector<std::vector<std::size_t>> dispatched(T);
+  std::vector<std::thread> threads;
+  for (std::size_t t = 0; t < T; t++) {
+    threads.emplace_back([&, t] {
+      // marks tasks of its own, and dispatches from all.
+      for (auto i = t; i < P * S; i += T) {
+        s->mark_ready(i % P, i / P);
+        if (i % 3 == 0)
+          if (auto task = s->dispatch(); task < s->size()) dispatched[t].push_back(task);
+      }
+      for (std::size_t task; (task = s->dispatch()) < s->size();) dispatched[t].push_back(task);
+    });
+  }
+  for (auto& th : threads) th.join();
+  std::vector<std::size_t> all;
+  for (auto& v : dispatched) all.insert(all.end(), v.begin(), v.end());
+  std::sort(all.begin(), all.end());
+  REQUIRE(all.size() == P * S);
+  for (std::size_t i = 0; i < P * S; i++) REQUIRE(all[i] == i);
+  REQUIRE(!s->any());
+}
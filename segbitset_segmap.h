@@ -0,0 +1,239 @@
+// Copyright (c) 2024 Chao Wang <hit9@icloud.com>.
+// License: BSD. https://github.com/hit9/segbitset
+// A sparse map from positions in [0, N) to values, storing the values densely in key order.
+//
+// Instead of a segbitset paired with a parallel array of N payloads, the values of present keys are stored
+// contiguously in key order, and the value of a key is located by its rank, the number of keys before it.
+// Keys are bits of 64-bit blocks, under a perfect binary tree of counts over the blocks in heap order,
+// so the parent of node x is x/2 and the leaf of block b is bit_ceil(blocks) + b:
+//
+//   rank(pos):  popcount of the bits before pos in its block, plus the counts of the left siblings on the
+//               path from its leaf to the root, O(logN).
+//   next(pos):  the count of a node is its OR summary (non-zero if any key below), so searches skip empty
+//               subtrees like segbitset, and foreach1 walks only the blocks having keys.
+//   insert/erase: O(logN) to locate and update the counts, plus moving the values after it in the vector,
+//               which costs nothing for appends in key order.
+// The build from sorted pairs costs O(pairs + N/64).
+//
+// Usage:
+//   segbitset::segmap<1024, std::string> m;
+//   m.insert(700, "a");
+//   m[3] = "b";
+//   m.foreach1([](std::size_t key, std::string& value) { ... });  // 3 "b", 700 "a"
+
+#ifndef __HIT9_SEGBITSET_SEGMAP
+#define __HIT9_SEGBITSET_SEGMAP
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "segbitset_heap.h"
+
+namespace segbitset {
+
+using size_t = std::size_t;
+
+template <size_t N, typename T>
+class segmap {
+  static_assert(N > 0);
+  static constexpr size_t B = (N + 63) >> 6;     // number of blocks
+  static constexpr size_t P = std::bit_ceil(B);  // number of leaves
+  using count_t = std::conditional_t<(N < (size_t(1) << 32)), uint32_t, uint64_t>;
+
+ public:
+  using key_type = size_t;
+  using mapped_type = T;
+
+  segmap() = default;
+  // builds from (key, value) pairs sorted by strictly increasing keys, in O(pairs + N/64).
+  // throws std::out_of_range if a key is not less than N, std::invalid_argument if keys aren't increasing.
+  template <typename InputIt>
+  segmap(InputIt first, InputIt last);
+
+  // returns the number of positions that this map holds, that is N.
+  constexpr size_t max_size() const noexcept { return N; }
+  // returns the number of keys.
+  size_t size() const noexcept { return counts[1]; }
+  bool empty() const noexcept { return !size(); }
+  // removes all keys.
+  void clear() noexcept;
+
+  // returns true if pos is a key, false if pos is out of range.
+  bool contains(size_t pos) const noexcept { return pos < N && ((masks[pos >> 6] >> (pos & 63)) & 1); }
+  // returns the number of keys less than pos, aka the index of the value of pos in values().
+  size_t rank(size_t pos) const noexcept;
+  // returns the pointer to the value of pos, nullptr if pos isn't a key.
+  T* find(size_t pos) noexcept { return contains(pos) ? &v[rank(pos)] : nullptr; }
+  const T* find(size_t pos) const noexcept { return contains(pos) ? &v[rank(pos)] : nullptr; }
+  // returns the value of pos, throws std::out_of_range if pos isn't a key.
+  T& at(size_t pos);
+  const T& at(size_t pos) const;
+  // returns the value of pos, inserting a default constructed one if pos isn't a key.
+  // throws std::out_of_range if pos is invalid.
+  T& operator[](size_t pos);
+
+  // inserts value as of key pos, returns false (and leaves the map unchanged) if pos is a key already.
+  // throws std::out_of_range if pos is invalid.
+  bool insert(size_t pos, T value);
+  // inserts or replaces the value of pos, returns true if inserted.
+  // throws std::out_of_range if pos is invalid.
+  bool insert_or_assign(size_t pos, T value);
+  // removes key pos and its value, returns false if pos isn't a key.
+  bool erase(size_t pos);
+
+  // find the first key, returns N if empty.
+  size_t first() const noexcept { return __find(0); }
+  // find the next key after given position, returns N if not found.
+  size_t next(size_t pos) const noexcept { return pos + 1 < N ? __find(pos + 1) : N; }
+  // iterates all keys from left to right, calling cb(key, value) for each.
+  template <typename Callback>
+  void foreach1(Callback&& cb);
+  template <typename Callback>
+  void foreach1(Callback&& cb) const;
+
+  // returns the values, in the order of their keys.
+  const std::vector<T>& values() const noexcept { return v; }
+
+ private:
+  uint64_t masks[B]{};      // keys of each block
+  count_t counts[2 * P]{};  // number of keys below each node, node 0 is unused
+  std::vector<T> v;         // values in key order
+
+  // adds delta to the counts from the leaf of block b to the root.
+  void __add(size_t b, count_t delta) noexcept {
+    for (auto x = P + b; x; x >>= 1) counts[x] += delta;
+  }
+  // inserts value as of key pos at index i of the values, pos isn't a key.
+  void __insert(size_t pos, size_t i, T&& value);
+  // returns the first block at or after b having keys, B if not found.
+  size_t __next_block(size_t b) const noexcept {
+    if (b >= B) return B;
+    auto x = __heap_find<P>(P + b, [this](size_t x) { return counts[x] != 0; });
+    return x ? x - P : B;
+  }
+  // returns the first key at or after pos, N if not found.
+  size_t __find(size_t pos) const noexcept;
+};
+
+template <size_t N, typename T>
+template <typename InputIt>
+segmap<N, T>::segmap(InputIt first, InputIt last) {
+  for (size_t prev = 0; first != last; ++first) {
+    auto&& pair = *first;
+    size_t pos = std::get<0>(pair);
+    if (pos >= N) throw std::out_of_range("segmap: key >= N");
+    if (!v.empty() && pos <= prev) throw std::invalid_argument("segmap: keys aren't increasing");
+    v.push_back(std::get<1>(std::forward<decltype(pair)>(pair)));  // first, for it may throw
+    masks[pos >> 6] |= uint64_t(1) << (pos & 63);
+    prev = pos;
+  }
+  for (size_t b = 0; b < B; b++) counts[P + b] = std::popcount(masks[b]);
+  for (auto x = P - 1; x; x--) counts[x] = counts[x << 1] + counts[x << 1 | 1];
+}
+
+template <size_t N, typename T>
+void segmap<N, T>::clear() noexcept {
+  for (auto& m : masks) m = 0;
+  for (auto& c : counts) c = 0;
+  v.clear();
+}
+
+template <size_t N, typename T>
+size_t segmap<N, T>::rank(size_t pos) const noexcept {
+  if (pos >= N) return size();
+  size_t b = pos >> 6, r = std::popcount(masks[b] & ((uint64_t(1) << (pos & 63)) - 1));
+  for (auto x = P + b; x > 1; x >>= 1)
+    if (x & 1) r += counts[x - 1];  // keys of the left sibling
+  return r;
+}
+
+template <size_t N, typename T>
+T& segmap<N, T>::at(size_t pos) {
+  if (!contains(pos)) throw std::out_of_range("segmap::at: no such key");
+  return v[rank(pos)];
+}
+
+template <size_t N, typename T>
+const T& segmap<N, T>::at(size_t pos) const {
+  if (!contains(pos)) throw std::out_of_range("segmap::at: no such key");
+  return v[rank(pos)];
+}
+
+template <size_t N, typename T>
+T& segmap<N, T>::operator[](size_t pos) {
+  if (pos >= N) throw std::out_of_range("segmap::operator[]: pos >= N");
+  auto i = rank(pos);
+  if (!contains(pos)) __insert(pos, i, T{});
+  return v[i];
+}
+
+template <size_t N, typename T>
+bool segmap<N, T>::insert(size_t pos, T value) {
+  if (pos >= N) throw std::out_of_range("segmap::insert: pos >= N");
+  if (contains(pos)) return false;
+  __insert(pos, rank(pos), std::move(value));
+  return true;
+}
+
+template <size_t N, typename T>
+bool segmap<N, T>::insert_or_assign(size_t pos, T value) {
+  if (pos >= N) throw std::out_of_range("segmap::insert_or_assign: pos >= N");
+  auto i = rank(pos);
+  if (!contains(pos)) {
+    __insert(pos, i, std::move(value));
+    return true;
+  }
+  v[i] = std::move(value);
+  return false;
+}
+
+template <size_t N, typename T>
+void segmap<N, T>::__insert(size_t pos, size_t i, T&& value) {
+  v.insert(v.begin() + i, std::move(value));  // first, for it may throw
+  masks[pos >> 6] |= uint64_t(1) << (pos & 63);
+  __add(pos >> 6, 1);
+}
+
+template <size_t N, typename T>
+bool segmap<N, T>::erase(size_t pos) {
+  if (!contains(pos)) return false;
+  v.erase(v.begin() + rank(pos));
+  masks[pos >> 6] &= ~(uint64_t(1) << (pos & 63));
+  __add(pos >> 6, count_t(-1));
+  return true;
+}
+
+template <size_t N, typename T>
+size_t segmap<N, T>::__find(size_t pos) const noexcept {
+  if (pos >= N) return N;
+  size_t b = pos >> 6;
+  if (auto m = masks[b] & (~uint64_t(0) << (pos & 63)); m) return (b << 6) + std::countr_zero(m);
+  b = __next_block(b + 1);
+  return b < B ? (b << 6) + std::countr_zero(masks[b]) : N;
+}
+
+template <size_t N, typename T>
+template <typename Callback>
+void segmap<N, T>::foreach1(Callback&& cb) {
+  size_t i = 0;
+  for (auto b = __next_block(0); b < B; b = __next_block(b + 1))
+    for (auto m = masks[b]; m; m &= m - 1) cb((b << 6) + std::countr_zero(m), v[i++]);
+}
+
+template <size_t N, typename T>
+template <typename Callback>
+void segmap<N, T>::foreach1(Callback&& cb) const {
+  size_t i = 0;
+  for (auto b = __next_block(0); b < B; b = __next_block(b + 1))
+    for (auto m = masks[b]; m; m &= m - 1) cb((b << 6) + std::countr_zero(m), std::as_const(v[i++]));
+}
+
+}  // namespace segbitset
+
+#endif
@@ -0,0 +1,113 @@
+#include "segbitset_segmap.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+static std::mt19937 rng(std::random_device{}());
+
+TEST_CASE("segmap", "[compare to std::map]") {
+  const std::size_t N = 5000;
+  std::uniform_int_distribution<std::size_t> distribution(0, N - 1);
+  auto m = std::make_unique<segbitset::segmap<N, int>>();
+  std::map<std::size_t, int> e;
+  REQUIRE(m->empty());
+  REQUIRE(m->first() == N);
+  for (int i = 0; i < 20000; i++) {
+    auto pos = distribution(rng);
+    switch (i % 5) {
+      case 0:
+        REQUIRE(m->insert(pos, i) == e.emplace(pos, i).second);
+        break;
+      case 1:
+        REQUIRE(m->insert_or_assign(pos, i) == e.insert_or_assign(pos, i).second);
+        break;
+      case 2:
+        REQUIRE(m->erase(pos) == bool(e.erase(pos)));
+        break;
+      case 3: {
+        auto it = e.find(pos);
+        auto p = m->find(pos);
+        REQUIRE((p == nullptr) == (it == e.end()));
+        if (p) REQUIRE(*p == it->second);
+        REQUIRE(m->rank(pos) == std::size_t(std::distance(e.begin(), e.lower_bound(pos))));
+        break;
+      }
+      case 4: {
+        auto it = e.upper_bound(pos);
+        REQUIRE(m->next(pos) == (it == e.end() ? N : it->first));
+        break;
+      }
+    }
+    REQUIRE(m->size() == e.size());
+  }
+  REQUIRE(m->rank(N) == e.size());
+  auto it = e.begin();
+  m->foreach1([&](std::size_t key, int& value) {
+    REQUIRE(key == it->first);
+    REQUIRE(value == it->second);
+    ++value;
+    ++it;
+  });
+  REQUIRE(it == e.end());
+  std::size_t i = 0;
+  for (auto& [key, value] : e) {
+    REQUIRE(m->values()[i++] == value + 1);
+    REQUIRE(m->at(key) == value + 1);
+  }
+  m->clear();
+  REQUIRE(m->empty());
+  REQUIRE(m->first() == N);
+}
+
+TEST_CASE("segmap", "[build from sorted pairs]") {
+  std::vector<std::pair<std::size_t, std::string>> pairs = {{0, "a"}, {63, "b"}, {64, "c"}, {999, "d"}};
+  segbitset::segmap<1000, std::string> m(pairs.begin(), pairs.end());
+  REQUIRE(m.size() == 4);
+  REQUIRE(m.first() == 0);
+  REQUIRE(m.next(0) == 63);
+  REQUIRE(m.next(63) == 64);
+  REQUIRE(m.next(64) == 999);
+  REQUIRE(m.next(999) == 1000);
+  REQUIRE(m.rank(64) == 2);
+  REQUIRE(m.at(999) == "d");
+  m[500] = "e";
+  REQUIRE(m.rank(999) == 4);
+  REQUIRE(m.values() == std::vector<std::string>{"a", "b", "c", "e", "d"});
+  REQUIRE_THROWS_AS(m.at(1), std::out_of_range);
+  REQUIRE_THROWS_AS(m.insert(1000, "x"), std::out_of_range);
+
+  std::vector<std::pair<std::size_t, std::string>> unsorted = {{5, "a"}, {5, "b"}};
+  REQUIRE_THROWS_AS((segbitset::segmap<1000, std::string>(unsorted.begin(), unsorted.end())),
+                    std::invalid_argument);
+  std::vector<std::pair<std::size_t, std::string>> out = {{1000, "a"}};
+  REQUIRE_THROWS_AS((segbitset::segmap<1000, std::string>(out.begin(), out.end())), std::out_of_range);
+
+  // values are moved from move iterators.
+  std::vector<std::pair<std::size_t, std::unique_ptr<int>>> owned;
+  owned.emplace_back(7, std::make_unique<int>(70));
+  segbitset::segmap<1000, std::unique_ptr<int>> moved(std::make_move_iterator(owned.begin()),
+                                                      std::make_move_iterator(owned.end()));
+  REQUIRE(*moved.at(7) == 70);
+  REQUIRE(!owned[0].second);
+}
+
+TEST_CASE("segmap", "[small sizes]") {
+  segbitset::segmap<1, int> m;
+  m[0] = 7;
+  REQUIRE(m.size() == 1);
+  REQUIRE(m.first() == 0);
+  REQUIRE(m.next(0) == 1);
+  REQUIRE(m.rank(0) == 0);
+  REQUIRE(m.rank(1) == 1);
+  const auto& c = m;
+  std::size_t cnt = 0;
+  c.foreach1([&](std::size_t key, const int& value) { cnt += key + value; });
+  REQUIRE(cnt == 7);
+}
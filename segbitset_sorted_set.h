@@ -0,0 +1,185 @@
+// Copyright (c) 2024 Chao Wang <hit9@icloud.com>.
+// License: BSD. https://github.com/hit9/segbitset
+// An ordered set of integers in [0, N) on a segbitset, with a std::set<size_t> compatible API.
+//
+// Drop-in for std::set of small integers: insert, erase, contains, find, lower_bound and upper_bound are
+// O(logN) walks on the segbitset, without node allocations, size() is O(1) on a maintained count, and
+// iterators are bidirectional, moving by next() and prev(). Like std::set, elements are immutable, so
+// iterator and const_iterator are the same. Iterators stay valid until their element is erased, except
+// that swap() exchanges the elements in O(N), not the storage, so it invalidates the iterators of both sets
+// instead of moving them along to the other set.
+//
+// Usage:
+//   segbitset::sorted_set<1024> s{3, 5, 700};
+//   s.insert(9);
+//   for (auto x : s) ...              // 3, 5, 9, 700
+//   auto it = s.lower_bound(6);       // *it == 9
+//   s.erase(it);
+
+#ifndef __HIT9_SEGBITSET_SORTED_SET
+#define __HIT9_SEGBITSET_SORTED_SET
+
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <utility>
+
+#include "segbitset.h"
+
+namespace segbitset {
+
+template <size_t N, template <size_t> class Storage = word_bitset, typename Stats = no_stats>
+class sorted_set {
+  using __sorted_set = sorted_set<N, Storage, Stats>;
+
+ public:
+  using key_type = size_t;
+  using value_type = size_t;
+  using size_type = size_t;
+  using difference_type = std::ptrdiff_t;
+
+  // iterator walks the elements in order, end() is position N.
+  class iterator {
+   public:
+    // bidirectional as a C++20 iterator, but dereferencing to a prvalue, so only an input iterator to the
+    // legacy iterator requirements, like the iterators of std::ranges::iota_view.
+    using iterator_concept = std::bidirectional_iterator_tag;
+    using iterator_category = std::input_iterator_tag;
+    using value_type = size_t;
+    using difference_type = std::ptrdiff_t;
+    using reference = size_t;  // elements are positions, returned by value
+    using pointer = void;
+
+    constexpr iterator() noexcept = default;
+    constexpr explicit iterator(const segbitset<N, Storage, Stats>* s, size_t pos) noexcept
+        : s(s), pos(pos) {}
+
+    constexpr size_t operator*() const noexcept { return pos; }
+    constexpr iterator& operator++() noexcept {
+      pos = s->next(pos);
+      return *this;
+    }
+    constexpr iterator operator++(int) noexcept {
+      auto it = *this;
+      ++*this;
+      return it;
+    }
+    // moves to the previous element, end() moves to the last element.
+    constexpr iterator& operator--() noexcept {
+      pos = s->prev(pos);
+      return *this;
+    }
+    constexpr iterator operator--(int) noexcept {
+      auto it = *this;
+      --*this;
+      return it;
+    }
+    constexpr bool operator==(const iterator& o) const noexcept { return pos == o.pos; }
+
+   private:
+    const segbitset<N, Storage, Stats>* s = nullptr;
+    size_t pos = N;
+  };
+  using const_iterator = iterator;
+  using reverse_iterator = std::reverse_iterator<iterator>;
+  using const_reverse_iterator = reverse_iterator;
+
+  constexpr sorted_set() noexcept = default;
+  // creates a set of given elements, throws std::out_of_range if any is not less than N.
+  constexpr sorted_set(std::initializer_list<size_t> elements) {
+    for (auto x : elements) insert(x);
+  }
+  // creates a set of the elements in [first, last), throws std::out_of_range if any is not less than N.
+  template <typename InputIt>
+  constexpr sorted_set(InputIt first, InputIt last) {
+    insert(first, last);
+  }
+
+  constexpr iterator begin() const noexcept { return iterator(&s, s.first()); }
+  constexpr iterator end() const noexcept { return iterator(&s, N); }
+  constexpr iterator cbegin() const noexcept { return begin(); }
+  constexpr iterator cend() const noexcept { return end(); }
+  constexpr reverse_iterator rbegin() const noexcept { return reverse_iterator(end()); }
+  constexpr reverse_iterator rend() const noexcept { return reverse_iterator(begin()); }
+
+  // returns the number of elements, O(1).
+  constexpr size_t size() const noexcept { return n; }
+  // returns the number of elements this set can hold, that is N.
+  constexpr size_t max_size() const noexcept { return N; }
+  constexpr bool empty() const noexcept { return !n; }
+  // removes all elements.
+  constexpr void clear() noexcept {
+    s.reset();
+    n = 0;
+  }
+
+  // inserts x, returns the iterator to x, and whether it was inserted (false if already present).
+  // throws std::out_of_range if x is not less than N.
+  constexpr std::pair<iterator, bool> insert(size_t x) {
+    bool inserted = s.try_set(x);
+    if (inserted) ++n;
+    return {iterator(&s, x), inserted};
+  }
+  // inserts x, the hint is ignored, for compatibility.
+  constexpr iterator insert(iterator, size_t x) { return insert(x).first; }
+  template <typename InputIt>
+  constexpr void insert(InputIt first, InputIt last) {
+    for (; first != last; ++first) insert(*first);
+  }
+  // inserts x, for compatibility with std::set::emplace.
+  constexpr std::pair<iterator, bool> emplace(size_t x) { return insert(x); }
+
+  // removes x, returns the number of elements removed (0 or 1), 0 if x is out of range.
+  constexpr size_t erase(size_t x) {
+    if (x >= N || !s.try_reset(x)) return 0;
+    --n;
+    return 1;
+  }
+  // removes the element at it, returns the iterator to the next element.
+  constexpr iterator erase(iterator it) {
+    auto next = std::next(it);
+    erase(*it);
+    return next;
+  }
+  // removes the elements in [first, last), returns last.
+  constexpr iterator erase(iterator first, iterator last) {
+    while (first != last) first = erase(first);
+    return last;
+  }
+
+  // returns true if x is in the set, false if x is out of range.
+  constexpr bool contains(size_t x) const { return x < N && s.test(x); }
+  // returns the number of elements equal to x (0 or 1).
+  constexpr size_t count(size_t x) const { return contains(x); }
+  // returns the iterator to x, or end() if not found.
+  constexpr iterator find(size_t x) const { return contains(x) ? iterator(&s, x) : end(); }
+  // returns the iterator to the first element not less than x, or end() if not found.
+  constexpr iterator lower_bound(size_t x) const noexcept {
+    if (x >= N) return end();
+    return iterator(&s, x ? s.next(x - 1) : s.first());
+  }
+  // returns the iterator to the first element greater than x, or end() if not found.
+  constexpr iterator upper_bound(size_t x) const noexcept { return x >= N ? end() : iterator(&s, s.next(x)); }
+  // returns the range of elements equal to x.
+  constexpr std::pair<iterator, iterator> equal_range(size_t x) const noexcept {
+    return {lower_bound(x), upper_bound(x)};
+  }
+
+  constexpr bool operator==(const __sorted_set& o) const noexcept { return n == o.n && s == o.s; }
+  // exchanges the elements with o in O(N). Unlike std::set, iterators of both sets are invalidated.
+  constexpr void swap(__sorted_set& o) noexcept {
+    std::swap(s, o.s);
+    std::swap(n, o.n);
+  }
+
+  // returns the underlying segbitset, e.g. for bulk operations.
+  constexpr const segbitset<N, Storage, Stats>& bits() const noexcept { return s; }
+
+ private:
+  segbitset<N, Storage, Stats> s;
+  size_t n = 0;  // number of elements
+};
+
+}  // namespace segbitset
+
+#endif
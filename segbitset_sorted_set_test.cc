@@ -0,0 +1,114 @@
+#include "segbitset_sorted_set.h"
+
+#include <algorithm>
+#include <catch2/catch_test_macros.hpp>
+#include <iterator>
+#include <ranges>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <vector>
+
+static std::mt19937 rng(std::random_device{}());
+
+static_assert(std::bidirectional_iterator<segbitset::sorted_set<64>::iterator>);
+static_assert(std::bidirectional_iterator<segbitset::sorted_set<1000>::reverse_iterator>);
+static_assert(std::ranges::bidirectional_range<segbitset::sorted_set<64>>);
+
+TEST_CASE("sorted_set", "[compare to std::set]") {
+  const std::size_t N = 1000;
+  std::uniform_int_distribution<std::size_t> distribution(0, N - 1);
+  segbitset::sorted_set<N> s;
+  std::set<std::size_t> e;
+  REQUIRE(s.empty());
+  REQUIRE(s.begin() == s.end());
+  for (int i = 0; i < 20000; i++) {
+    auto x = distribution(rng);
+    switch (i % 5) {
+      case 0:
+      case 1: {
+        auto [it, inserted] = s.insert(x);
+        REQUIRE(inserted == e.insert(x).second);
+        REQUIRE(*it == x);
+        break;
+      }
+      case 2:
+        REQUIRE(s.erase(x) == e.erase(x));
+        break;
+      case 3: {
+        auto it = s.lower_bound(x);
+        auto jt = e.lower_bound(x);
+        REQUIRE((it == s.end()) == (jt == e.end()));
+        if (jt != e.end()) REQUIRE(*it == *jt);
+        it = s.upper_bound(x), jt = e.upper_bound(x);
+        REQUIRE((it == s.end()) == (jt == e.end()));
+        if (jt != e.end()) REQUIRE(*it == *jt);
+        break;
+      }
+      case 4:
+        REQUIRE(s.contains(x) == e.contains(x));
+        REQUIRE((s.find(x) == s.end()) == (e.find(x) == e.end()));
+        break;
+    }
+    REQUIRE(s.size() == e.size());
+  }
+  REQUIRE(std::equal(s.begin(), s.end(), e.begin(), e.end()));
+  REQUIRE(std::equal(s.rbegin(), s.rend(), e.rbegin(), e.rend()));
+}
+
+TEST_CASE("sorted_set", "[bidirectional iterators]") {
+  segbitset::sorted_set<37> s{3, 5, 36};
+  auto it = s.end();
+  REQUIRE(*--it == 36);
+  REQUIRE(*--it == 5);
+  REQUIRE(*it-- == 5);
+  REQUIRE(*it == 3);
+  REQUIRE(it == s.begin());
+  REQUIRE(*++it == 5);
+  REQUIRE(*it++ == 5);
+  REQUIRE(*it == 36);
+  REQUIRE(++it == s.end());
+  std::vector<std::size_t> v(s.rbegin(), s.rend());
+  REQUIRE(v == std::vector<std::size_t>{36, 5, 3});
+}
+
+TEST_CASE("sorted_set", "[erase by iterators and bounds]") {
+  std::vector<std::size_t> elements = {1, 2, 10, 20, 30, 63};
+  segbitset::sorted_set<64> s(elements.begin(), elements.end());
+  REQUIRE(s.size() == 6);
+  auto it = s.erase(s.find(10));
+  REQUIRE(*it == 20);
+  s.erase(s.lower_bound(2), s.upper_bound(30));
+  REQUIRE(std::vector<std::size_t>(s.begin(), s.end()) == std::vector<std::size_t>{1, 63});
+  REQUIRE(s.size() == 2);
+  REQUIRE(s.lower_bound(64) == s.end());
+  REQUIRE(s.upper_bound(63) == s.end());
+  REQUIRE(*s.lower_bound(0) == 1);
+  REQUIRE(s.count(63) == 1);
+  REQUIRE(s.erase(1000) == 0);
+  REQUIRE(!s.contains(1000));
+  REQUIRE_THROWS_AS(s.insert(64), std::out_of_range);
+  s.clear();
+  REQUIRE(s.empty());
+  REQUIRE(s.begin() == s.end());
+}
+
+TEST_CASE("sorted_set", "[constexpr]") {
+  static constexpr auto s = [] {
+    segbitset::sorted_set<128> s{'a', 'z', 'm'};
+    s.erase('m');
+    return s;
+  }();
+  static_assert(s.size() == 2);
+  static_assert(*s.begin() == 'a');
+  static_assert(*--s.end() == 'z');
+}
+
+TEST_CASE("sorted_set", "[swap exchanges the elements]") {
+  segbitset::sorted_set<64> a{1, 2}, b{40};
+  a.swap(b);
+  REQUIRE(std::vector<std::size_t>(a.begin(), a.end()) == std::vector<std::size_t>{40});
+  REQUIRE(std::vector<std::size_t>(b.begin(), b.end()) == std::vector<std::size_t>{1, 2});
+  REQUIRE(a.size() == 1);
+  REQUIRE(b.size() == 2);
+}
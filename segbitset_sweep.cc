@@ -0,0 +1,366 @@
+// Benchmark sweeping distribution x size x density x operation, comparing segbitset against std::bitset
+// and a plain std::vector<uint64_t> (flat bitset), to find out when the tree pays off on the running host.
+// See segbitset_generators.h for the data distributions.
+//
+// Results are printed as tab-separated tables:
+//   1. timings, one row per (impl, distribution, n, density, op), in nanoseconds per call,
+//      with the actual density of the generated data.
+//   2. crossovers, one row per (distribution, n, op): the lowest density at which segbitset is no longer
+//      the fastest, inf if segbitset is the fastest at all densities, 0 if it's never the fastest.
+//   3. hardware counters (see segbitset_perf.h), one row per
+//      (impl, distribution, n, density, op, event, unit), counted on the fastest sample. Point operations
+//      (set and test) are normalized per position accessed, the others per bit and per set bit.
+//      Skipped if the host has no counters available.
+//
+// Usage: segbitset_sweep [max_n] [distribution ...]
+//   max_n limits the sizes to sweep, defaults to 1M, pass 1G to sweep all sizes (takes hours).
+//   distributions default to all.
+
+#include <algorithm>
+#include <bit>
+#include <bitset>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "segbitset.h"
+#include "segbitset_generators.h"
+#include "segbitset_perf.h"
+
+static std::mt19937_64 rng(std::random_device{}());
+static volatile std::size_t sink;  // avoid compiler optimization away
+
+static const std::vector<double> DENSITIES = {0.00001, 0.0001, 0.001, 0.01, 0.02, 0.05, 0.1, 0.25, 0.5, 0.9};
+static const std::size_t N_POINT_OPS = 1 << 16;  // number of random positions for set and test
+
+////////////////////////////////////////
+/// Implementations under test
+////////////////////////////////////////
+
+// flat_bitset is the baseline of a plain array of words.
+template <std::size_t N>
+struct flat_bitset {
+  std::vector<uint64_t> w = std::vector<uint64_t>((N + 63) >> 6);
+
+  void set(std::size_t pos) { w[pos >> 6] |= uint64_t(1) << (pos & 63); }
+  bool test(std::size_t pos) const { return (w[pos >> 6] >> (pos & 63)) & 1; }
+  std::size_t count() const {
+    std::size_t n = 0;
+    for (auto x : w) n += std::popcount(x);
+    return n;
+  }
+  std::size_t next(std::size_t pos) const {  // the first true bit at or after pos, N if not found.
+    if (pos >= N) return N;
+    auto i = pos >> 6;
+    auto x = w[i] & (~uint64_t(0) << (pos & 63));
+    while (!x) {
+      if (++i == w.size()) return N;
+      x = w[i];
+    }
+    return (i << 6) + std::countr_zero(x);
+  }
+  template <typename Callback>
+  void foreach1(Callback&& cb) const {
+    for (std::size_t i = 0; i < w.size(); i++)
+      for (auto x = w[i]; x; x &= x - 1) cb((i << 6) + std::countr_zero(x));
+  }
+  void flip() {
+    for (auto& x : w) x = ~x;
+    if (N & 63) w.back() &= (uint64_t(1) << (N & 63)) - 1;
+  }
+  void reset() { std::fill(w.begin(), w.end(), 0); }
+  flat_bitset& operator&=(const flat_bitset& o) {
+    for (std::size_t i = 0; i < w.size(); i++) w[i] &= o.w[i];
+    return *this;
+  }
+  flat_bitset& operator|=(const flat_bitset& o) {
+    for (std::size_t i = 0; i < w.size(); i++) w[i] |= o.w[i];
+    return *this;
+  }
+  flat_bitset& operator^=(const flat_bitset& o) {
+    for (std::size_t i = 0; i < w.size(); i++) w[i] ^= o.w[i];
+    return *this;
+  }
+  bool operator==(const flat_bitset& o) const { return w == o.w; }
+};
+
+// impl adapts each implementation to a common interface, b is on heap since they can be large.
+template <std::size_t N, typename B>
+struct impl;
+
+template <std::size_t N>
+struct impl<N, std::bitset<N>> {
+  static constexpr const char* name = "std::bitset";
+  std::unique_ptr<std::bitset<N>> b = std::make_unique<std::bitset<N>>();
+  explicit impl(const flat_bitset<N>& a) { a.foreach1([&](std::size_t pos) { b->set(pos); }); }
+  std::size_t first_next() const {  // std::bitset has no way to find true bits but testing one by one.
+    std::size_t n = 0;
+    for (std::size_t pos = 0; pos < N; pos++) n += (*b)[pos];
+    return n;
+  }
+  std::size_t foreach1() const { return first_next(); }
+};
+
+template <std::size_t N>
+struct impl<N, segbitset::segbitset<N>> {
+  static constexpr const char* name = "segbitset";
+  // builds from an std::bitset, which is much faster than setting dense bits one by one.
+  std::unique_ptr<segbitset::segbitset<N>> b;
+  explicit impl(const flat_bitset<N>& a)
+      : b(std::make_unique<segbitset::segbitset<N>>(*impl<N, std::bitset<N>>(a).b)) {}
+  std::size_t first_next() const {
+    std::size_t n = 0;
+    for (auto pos = b->first(); pos != N; pos = b->next(pos)) ++n;
+    return n;
+  }
+  std::size_t foreach1() const {
+    std::size_t n = 0;
+    b->foreach1([&](std::size_t) { ++n; });
+    return n;
+  }
+};
+
+template <std::size_t N>
+struct impl<N, flat_bitset<N>> {
+  static constexpr const char* name = "flat";
+  std::unique_ptr<flat_bitset<N>> b;
+  explicit impl(const flat_bitset<N>& a) : b(std::make_unique<flat_bitset<N>>(a)) {}
+  std::size_t first_next() const {
+    std::size_t n = 0;
+    for (auto pos = b->next(0); pos != N; pos = b->next(pos + 1)) ++n;
+    return n;
+  }
+  std::size_t foreach1() const {
+    std::size_t n = 0;
+    b->foreach1([&](std::size_t) { ++n; });
+    return n;
+  }
+};
+
+////////////////////////////////////////
+/// Timing
+////////////////////////////////////////
+
+using clock_type = std::chrono::steady_clock;
+static const auto MIN_SAMPLE_TIME = std::chrono::milliseconds(2);
+static const int SAMPLES = 3;
+static const std::size_t MAX_COPIES_BYTES = 256 << 20, MAX_COPIES = 1 << 12;
+static segbitset::perf::counters counters;
+
+// measurement is the time and the hardware counters per call of an operation.
+struct measurement {
+  double ns;
+  segbitset::perf::sample perf;
+};
+
+template <typename T>
+std::size_t bytes_of(const T& a) {
+  if constexpr (requires { a.w.size(); })
+    return a.w.size() * sizeof(a.w[0]);
+  else
+    return sizeof(T);
+}
+
+// returns the best time of op in nanoseconds per call, batching calls to make each sample long enough.
+template <typename F>
+measurement measure(F&& op) {
+  measurement best{1e300, {}};
+  std::size_t batch = 1;
+  for (int i = 0; i < SAMPLES;) {
+    counters.start();
+    auto start = clock_type::now();
+    for (std::size_t j = 0; j < batch; j++) op();
+    auto elapsed = clock_type::now() - start;
+    auto perf = counters.stop();
+    if (elapsed < MIN_SAMPLE_TIME && batch < (1 << 20)) {
+      batch <<= 1;
+      continue;
+    }
+    auto ns = std::chrono::duration<double, std::nano>(elapsed).count() / batch;
+    if (ns < best.ns) best = {ns, perf / batch};
+    i++;
+  }
+  return best;
+}
+
+// like measure, but each call of op runs on a fresh copy of a, for operations modifying their operand.
+template <typename T, typename F>
+measurement measure_on_copies(const T& a, F&& op) {
+  measurement best{1e300, {}};
+  std::size_t batch = 1, max_batch = std::clamp<std::size_t>(MAX_COPIES_BYTES / bytes_of(a), 1, MAX_COPIES);
+  for (int i = 0; i < SAMPLES;) {
+    std::vector<std::unique_ptr<T>> copies(batch);
+    for (auto& c : copies) c = std::make_unique<T>(a);
+    counters.start();
+    auto start = clock_type::now();
+    for (auto& c : copies) op(*c);
+    auto elapsed = clock_type::now() - start;
+    auto perf = counters.stop();
+    if (elapsed < MIN_SAMPLE_TIME && batch < max_batch) {
+      batch = std::min(batch << 1, max_batch);
+      continue;
+    }
+    auto ns = std::chrono::duration<double, std::nano>(elapsed).count() / batch;
+    if (ns < best.ns) best = {ns, perf / batch};
+    i++;
+  }
+  return best;
+}
+
+////////////////////////////////////////
+/// Sweep
+////////////////////////////////////////
+
+struct row {
+  std::string impl;
+  std::string distribution;
+  std::size_t n;
+  double density, actual_density;
+  std::string op;
+  double ns;
+  segbitset::perf::sample perf;  // per call
+  std::size_t positions;         // number of positions accessed by a call of a point operation, 0 for others
+  std::size_t set_bits;
+};
+
+static std::vector<row> rows;
+
+template <std::size_t N, typename B>
+void sweep_impl(const char* distribution, double density, const flat_bitset<N>& a, const flat_bitset<N>& b,
+                const std::vector<std::size_t>& positions) {
+  using I = impl<N, B>;
+  auto x = std::make_unique<I>(a), y = std::make_unique<I>(b), z = std::make_unique<I>(a);
+  auto actual_density = double(a.count()) / N;
+  auto add = [&](const char* op, measurement m, std::size_t n_positions = 0) {
+    rows.push_back(
+        {I::name, distribution, N, density, actual_density, op, m.ns, m.perf, n_positions, a.count()});
+  };
+  add(
+      "set", measure_on_copies(*x->b, [&](B& c) {
+        for (auto pos : positions) c.set(pos);
+      }),
+      positions.size());
+  add(
+      "test", measure([&] {
+        std::size_t n = 0;
+        for (auto pos : positions) n += x->b->test(pos);
+        sink = n;
+      }),
+      positions.size());
+  add("count", measure([&] { sink = x->b->count(); }));
+  add("first/next", measure([&] { sink = x->first_next(); }));
+  add("foreach1", measure([&] { sink = x->foreach1(); }));
+  add("&=", measure_on_copies(*x->b, [&](B& c) { c &= *y->b; }));
+  add("|=", measure_on_copies(*x->b, [&](B& c) { c |= *y->b; }));
+  add("^=", measure_on_copies(*x->b, [&](B& c) { c ^= *y->b; }));
+  add("==", measure([&] { sink = *x->b == *z->b; }));  // equal operands, the worst case.
+  add("flip", measure_on_copies(*x->b, [](B& c) { c.flip(); }));
+  add("reset", measure_on_copies(*x->b, [](B& c) { c.reset(); }));
+}
+
+template <std::size_t N>
+void sweep(std::size_t max_n, const std::vector<segbitset::generators::distribution>& distributions) {
+  if (N > max_n) return;
+  std::uniform_int_distribution<std::size_t> uniform(0, N - 1);
+  std::vector<std::size_t> positions(N_POINT_OPS);
+  for (auto& pos : positions) pos = uniform(rng);
+
+  for (auto d : distributions) {
+    auto distribution = segbitset::generators::name(d);
+    for (auto density : DENSITIES) {
+      std::fprintf(stderr, "sweeping %s n=%zu density=%g\n", distribution, N, density);
+      auto a = std::make_unique<flat_bitset<N>>(), b = std::make_unique<flat_bitset<N>>();
+      segbitset::generators::generate(d, N, density, rng, [&](std::size_t pos) { a->set(pos); });
+      segbitset::generators::generate(d, N, density, rng, [&](std::size_t pos) { b->set(pos); });
+      sweep_impl<N, segbitset::segbitset<N>>(distribution, density, *a, *b, positions);
+      sweep_impl<N, std::bitset<N>>(distribution, density, *a, *b, positions);
+      sweep_impl<N, flat_bitset<N>>(distribution, density, *a, *b, positions);
+    }
+  }
+}
+
+void print() {
+  std::printf("impl\tdistribution\tn\tdensity\tactual_density\top\tns\n");
+  for (auto& r : rows)
+    std::printf("%s\t%s\t%zu\t%g\t%g\t%s\t%.1f\n", r.impl.c_str(), r.distribution.c_str(), r.n, r.density,
+                r.actual_density, r.op.c_str(), r.ns);
+
+  std::printf("\ndistribution\tn\top\tcrossover_density\n");
+  std::vector<std::tuple<std::string, std::size_t, std::string>> keys;  // in order of appearance
+  for (auto& r : rows) {
+    auto key = std::make_tuple(r.distribution, r.n, r.op);
+    if (std::find(keys.begin(), keys.end(), key) == keys.end()) keys.push_back(key);
+  }
+  for (auto& [distribution, n, op] : keys) {
+    auto crossover = std::numeric_limits<double>::infinity();
+    for (auto density : DENSITIES) {
+      double seg = 1e300, others = 1e300;
+      for (auto& r : rows) {
+        if (r.distribution != distribution || r.n != n || r.op != op || r.density != density) continue;
+        if (r.impl == "segbitset")
+          seg = r.ns;
+        else
+          others = std::min(others, r.ns);
+      }
+      if (seg >= others) {
+        crossover = density == DENSITIES.front() ? 0 : density;
+        break;
+      }
+    }
+    std::printf("%s\t%zu\t%s\t%g\n", distribution.c_str(), n, op.c_str(), crossover);
+  }
+
+  if (!counters.available()) {
+    std::fprintf(stderr, "hardware counters are unavailable, skipped the counters table\n");
+    return;
+  }
+  std::printf("\nimpl\tdistribution\tn\tdensity\top\tevent\tunit\tcount\n");
+  for (auto& r : rows) {
+    for (auto e : segbitset::perf::all) {
+      if (!counters.available(e)) continue;
+      auto row = [&](const char* unit, double count) {
+        std::printf("%s\t%s\t%zu\t%g\t%s\t%s\t%s\t%g\n", r.impl.c_str(), r.distribution.c_str(), r.n,
+                    r.density, r.op.c_str(), segbitset::perf::name(e), unit, count);
+      };
+      row("call", r.perf[e]);
+      if (r.positions) {
+        row("position", r.perf[e] / r.positions);
+      } else {
+        row("bit", r.perf[e] / r.n);
+        if (r.set_bits) row("set_bit", r.perf[e] / r.set_bits);
+      }
+    }
+  }
+}
+
+int main(int argc, char* argv[]) {
+  std::size_t max_n = 1 << 20;
+  if (argc > 1) {
+    std::string s = argv[1];
+    max_n = std::strtoull(s.c_str(), nullptr, 10);
+    if (s.back() == 'K') max_n <<= 10;
+    if (s.back() == 'M') max_n <<= 20;
+    if (s.back() == 'G') max_n <<= 30;
+  }
+  std::vector<segbitset::generators::distribution> distributions;
+  for (int i = 2; i < argc; i++)
+    for (auto d : segbitset::generators::all)
+      if (std::string(argv[i]) == segbitset::generators::name(d)) distributions.push_back(d);
+  if (distributions.empty())
+    distributions.assign(std::begin(segbitset::generators::all), std::end(segbitset::generators::all));
+
+  sweep<1 << 10>(max_n, distributions);
+  sweep<1 << 16>(max_n, distributions);
+  sweep<1 << 20>(max_n, distributions);
+  sweep<16 << 20>(max_n, distributions);
+  sweep<1 << 30>(max_n, distributions);
+  print();
+  return 0;
+}
@@ -1,9 +1,14 @@
 #include "segbitset.h"
+#include "segbitset_generators.h"
 
 #include <bitset>
 #include <catch2/catch_template_test_macros.hpp>
 #include <catch2/catch_test_macros.hpp>
+#include <memory>
 #include <random>
+#include <stdexcept>
+#include <utility>
+#include <vector>
 
 static std::mt19937 rng(std::random_device{}());
 
@@ -187,6 +192,21 @@ TEST_CASE("flip", "[flip a single position]") {
   REQUIRE(!s[5]);
 }
 
+TEST_CASE("try_set/try_reset", "[set or reset a single position, reporting a change]") {
+  segbitset::segbitset<1000, segbitset::word_bitset, segbitset::no_stats, segbitset::count_summary> s;
+  REQUIRE(s.try_set(500));
+  REQUIRE(!s.try_set(500));
+  REQUIRE(s.try_set(3));
+  REQUIRE(s.summary() == 2);
+  REQUIRE(s.first() == 3);
+  REQUIRE(s.try_reset(3));
+  REQUIRE(!s.try_reset(3));
+  REQUIRE(s.summary() == 1);
+  REQUIRE(s.first() == 500);
+  REQUIRE_THROWS_AS(s.try_set(1000), std::out_of_range);
+  REQUIRE_THROWS_AS(s.try_reset(1000), std::out_of_range);
+}
+
 TEST_CASE("first/next", "[find positions of true bits - simple]") {
   std::bitset<8> b;
   b.set(0);
@@ -248,6 +268,27 @@ TEST_CASE("first/next", "[find positions of true bits - large]") {
   REQUIRE(pos == 1024);  // not found
 }
 
+TEST_CASE("last/prev", "[find positions of true bits from right to left]") {
+  segbitset::segbitset<8> e;
+  REQUIRE(e.last() == 8);
+  REQUIRE(e.prev(5) == 8);
+
+  for (int i = 0; i < 16; i++) {
+    auto b = make_random_bitset<1000>();
+    segbitset::segbitset<1000> s(b);
+    std::size_t expect = 1000;  // last true bit before pos
+    for (std::size_t pos = 0; pos <= 1000; pos++) {
+      REQUIRE(s.prev(pos) == expect);
+      if (pos < 1000 && b[pos]) expect = pos;
+    }
+    REQUIRE(s.last() == expect);
+    REQUIRE(s.prev(100000) == expect);  // out of range finds the last
+  }
+  static_assert(segbitset::segbitset<37>::from_positions({0, 5, 36}).prev(36) == 5);
+  static_assert(segbitset::segbitset<37>::from_positions({0, 5, 36}).last() == 36);
+  static_assert(segbitset::segbitset<1>::from_positions({0}).last() == 0);
+}
+
 TEST_CASE("foreach1", "[iterate each 1 - simple]") {
   std::bitset<8> b;
   b.set(2);
@@ -283,6 +324,38 @@ TEST_CASE("foreach1", "[iterate each 1 - large]") {
   REQUIRE(cnt == b.count());
 }
 
+TEST_CASE("foreach1", "[iterate each 1 in a range and in subtrees]") {
+  const std::size_t N = 1000;
+  auto b = make_random_bitset<N>();
+  segbitset::segbitset<N> s(b);
+  std::uniform_int_distribution<std::size_t> distribution(0, N);
+  for (int i = 0; i < 100; i++) {
+    auto first = distribution(rng), last = distribution(rng);
+    if (first > last) std::swap(first, last);
+    std::vector<std::size_t> got, want;
+    s.foreach1(first, last, [&](std::size_t pos) { got.push_back(pos); });
+    for (auto pos = first; pos < last; pos++)
+      if (b[pos]) want.push_back(pos);
+    REQUIRE(got == want);
+  }
+  REQUIRE_THROWS_AS(s.foreach1(0, N + 1, [](std::size_t) {}), std::out_of_range);
+  REQUIRE_THROWS_AS(s.foreach1(3, 2, [](std::size_t) {}), std::out_of_range);
+
+  // subtrees at each depth cover all positions in order, deeper than the leaves too.
+  for (std::size_t depth = 0; depth <= 12; depth++) {
+    std::size_t next = 0;
+    for (std::size_t i = 0; i < (std::size_t(1) << depth); i++) {
+      auto [first, last] = segbitset::segbitset<N>::subtree_range(depth, i);
+      REQUIRE(first == next);
+      REQUIRE(first <= last);
+      next = last;
+    }
+    REQUIRE(next == N);
+  }
+  static_assert(segbitset::segbitset<8>::subtree_range(0, 0) == std::pair<std::size_t, std::size_t>{0, 8});
+  static_assert(segbitset::segbitset<8>::subtree_range(1, 1) == std::pair<std::size_t, std::size_t>{4, 8});
+}
+
 TEST_CASE("operatopr==", "[test operator equal]") {
   segbitset::segbitset<8> s1;
   s1.set(1);
@@ -363,3 +436,373 @@ TEST_CASE("operatopr^", "[test operator and: a ^ b]") {
   segbitset::segbitset<1024> s3(std::bitset<1024>(777 ^ 991));
   REQUIRE((s1 ^ s2) == s3);
 }
+
+TEST_CASE("constexpr", "[build and query at compile time]") {
+  static constexpr auto s = segbitset::segbitset<128>::from_positions({'0', '1', '7', '9', 'a', 'z'});
+  static_assert(s.count() == 6);
+  static_assert(s.first() == '0');
+  static_assert(s.next('0') == '1');
+  static_assert(s.next('1') == '7');
+  static_assert(s.next('9') == 'a');
+  static_assert(s.next('z') == 128);  // not found
+  static_assert(s.test('a') && !s.test('b'));
+  static_assert(s.any() && !s.all());
+  static_assert(s == segbitset::segbitset<128>::from_positions({'z', 'a', '9', '7', '1', '0'}));
+  static_assert((s & segbitset::segbitset<128>::from_positions({'1', 'a', 'b'})).count() == 2);
+  static_assert((~s).count() == 128 - 6);
+  static_assert([] {
+    std::size_t sum = 0;
+    s.foreach1([&](std::size_t pos) { sum += pos; });
+    return sum;
+  }() == '0' + '1' + '7' + '9' + 'a' + 'z');
+  REQUIRE(s['7']);
+}
+
+TEST_CASE("storage", "[std::bitset as storage]") {
+  auto b = make_random_bitset<1024>();
+  segbitset::segbitset<1024, std::bitset> s(b);
+  REQUIRE(b == s.to_bitset());
+  REQUIRE(s.count() == b.count());
+  s.flip();
+  REQUIRE(~b == s.to_bitset());
+  s.set(3, false);
+  REQUIRE(!s[3]);
+}
+
+TEST_CASE("walk", "[bulk operations - compare to bitset]") {
+  for (int i = 0; i < 64; i++) {
+    auto b1 = make_random_bitset<1000>(), b2 = make_random_bitset<1000>();
+    segbitset::segbitset<1000> s1(b1), s2(b2);
+    REQUIRE((s1 & s2).to_bitset() == (b1 & b2));
+    REQUIRE((s1 | s2).to_bitset() == (b1 | b2));
+    REQUIRE((s1 ^ s2).to_bitset() == (b1 ^ b2));
+    REQUIRE((s1 ^ s2).count() == (b1 ^ b2).count());
+    REQUIRE((s1 == s2) == (b1 == b2));
+    REQUIRE(s1 == segbitset::segbitset<1000>(b1));
+    REQUIRE(s1.all() == b1.all());
+    s1.reset();
+    REQUIRE(s1.none());
+    REQUIRE(s1.count() == 0);
+  }
+}
+
+TEST_CASE("storage", "[van Emde Boas layout]") {
+  for (int i = 0; i < 16; i++) {
+    auto b1 = make_random_bitset<1000>(), b2 = make_random_bitset<1000>();
+    segbitset::segbitset<1000, segbitset::veb_bitset> s1(b1), s2(b2);
+    REQUIRE(s1.to_bitset() == b1);
+    REQUIRE(s1.count() == b1.count());
+    REQUIRE((s1 & s2).to_bitset() == (b1 & b2));
+    REQUIRE((s1 | s2).to_bitset() == (b1 | b2));
+    REQUIRE((s1 ^ s2).to_bitset() == (b1 ^ b2));
+    REQUIRE((~s1).to_bitset() == ~b1);
+    for (std::size_t pos = s1.first(), j = 0; j < 1000; j++) {
+      if (b1[j]) {
+        REQUIRE(pos == j);
+        pos = s1.next(pos);
+      }
+    }
+    s1.set(999, false);
+    REQUIRE(!s1[999]);
+    s1.set(999);
+    REQUIRE(s1[999]);
+  }
+  static_assert(segbitset::segbitset<7, segbitset::veb_bitset>::from_positions({1, 6}).next(1) == 6);
+}
+
+TEST_CASE("generators", "[bulk operations on each distribution - compare to bitset]") {
+  for (auto d : segbitset::generators::all) {
+    for (auto density : {0.001, 0.02, 0.3, 0.9}) {
+      std::bitset<4000> b1, b2;
+      segbitset::generators::generate(d, 4000, density, rng, [&](std::size_t pos) { b1.set(pos); });
+      segbitset::generators::generate(d, 4000, density, rng, [&](std::size_t pos) { b2.set(pos); });
+      segbitset::segbitset<4000> s1(b1), s2(b2);
+      REQUIRE(s1.count() == b1.count());
+      REQUIRE((s1 & s2).to_bitset() == (b1 & b2));
+      REQUIRE((s1 | s2).to_bitset() == (b1 | b2));
+      REQUIRE((s1 ^ s2).to_bitset() == (b1 ^ b2));
+      REQUIRE((~s1).to_bitset() == ~b1);
+      std::size_t cnt = 0;
+      s1.foreach1([&](std::size_t pos) { cnt += b1[pos]; });
+      REQUIRE(cnt == b1.count());
+    }
+  }
+}
+
+TEST_CASE("generators", "[density of generated data]") {
+  for (auto d : segbitset::generators::all) {
+    if (d == segbitset::generators::distribution::zipfian) continue;  // hot blocks saturate
+    std::size_t n = 0, out_of_range = 0;
+    segbitset::generators::generate(d, 1 << 20, 0.1, rng, [&](std::size_t pos) {
+      out_of_range += pos >= (1 << 20);
+      ++n;
+    });
+    REQUIRE(out_of_range == 0);
+    REQUIRE(n > (1 << 20) * 0.08);
+    REQUIRE(n < (1 << 20) * 0.12);
+  }
+}
+
+TEST_CASE("pop_first", "[pops true bits from left to right]") {
+  segbitset::segbitset<1000> s;
+  REQUIRE(s.pop_first() == 1000);
+  s.set(999).set(3).set(500);
+  REQUIRE(s.pop_first() == 3);
+  REQUIRE(s.pop_first() == 500);
+  REQUIRE(s.pop_first() == 999);
+  REQUIRE(s.pop_first() == 1000);
+  REQUIRE(s.none());
+}
+
+TEST_CASE("stats", "[counting tree walks]") {
+  using segbitset::stats_op;
+  static_assert(sizeof(segbitset::segbitset<1000>) == sizeof(segbitset::word_bitset<4001>));  // zero-cost
+
+  segbitset::segbitset<1000, segbitset::word_bitset, segbitset::counting_stats> s, t;
+  s.set(1).set(500);
+  auto c = s.stats();
+  REQUIRE(c[stats_op::find].visited == 2 * 11);  // 11 levels, from root to leaf
+  REQUIRE(c[stats_op::find].leaves == 2);
+  REQUIRE(c[stats_op::update].pushups == 2 * 10);
+
+  s.reset_stats();
+  REQUIRE(s.stats()[stats_op::find].visited == 0);
+  std::size_t cnt = 0;
+  s.foreach1([&](std::size_t) { ++cnt; });
+  REQUIRE(cnt == 2);
+  c = s.stats();
+  REQUIRE(c[stats_op::foreach1].leaves >= 2);  // and empty siblings
+  REQUIRE(c[stats_op::foreach1].pruned > 0);
+  REQUIRE(c[stats_op::foreach1].visited < 100);  // pruned the empty subtrees
+  REQUIRE(c[stats_op::next].visited == 0);
+
+  REQUIRE(s.first() == 1);
+  REQUIRE(s.next(1) == 500);
+  REQUIRE(s.stats()[stats_op::next].leaves >= 2);  // first() and next() reach a leaf each
+
+  t.set(500);
+  s &= t;
+  REQUIRE(s.count() == 1);
+  c = s.stats();
+  REQUIRE(c[stats_op::and_assign].pushups > 0);
+  REQUIRE(c[stats_op::and_assign].leaves >= 2);
+  REQUIRE(c[stats_op::count].leaves <= 2);  // the set bit and its sibling
+}
+
+TEST_CASE("profile", "[density, blocks, runs and footprint]") {
+  segbitset::segbitset<1000> s;
+  auto p = s.profile();
+  REQUIRE(p.count == 0);
+  REQUIRE(p.runs == 0);
+  REQUIRE(p.levels[0].nonzero == 0);
+  REQUIRE(p.blocks == 16);
+  REQUIRE(p.bytes == sizeof(s));
+  REQUIRE(p.capacity == s.capacity());
+
+  for (std::size_t pos = 0; pos < 10; pos++) s.set(pos);
+  s.set(100).set(102).set(999);
+  p = s.profile();
+  REQUIRE(p.count == 13);
+  REQUIRE(p.runs == 4);
+  REQUIRE(p.longest_run == 10);
+  REQUIRE(p.mean_run() == 13.0 / 4);
+  REQUIRE(p.nonzero_blocks == 3);
+  REQUIRE(p.depth == 11);
+  REQUIRE(p.levels[0].nodes == 1);
+  REQUIRE(p.levels[0].density() == 1);
+  std::size_t nodes = 0, nonzero = 0;
+  for (std::size_t d = 0; d < p.depth; d++) {
+    nodes += p.levels[d].nodes;
+    nonzero += p.levels[d].nonzero;
+    REQUIRE(p.levels[d].nonzero <= p.levels[d].nodes);
+  }
+  REQUIRE(nodes == 2 * 1000 - 1);
+  REQUIRE(nonzero > 13);
+  REQUIRE(p.levels[1].density() == 1);  // both halves have true bits
+
+  // number of nodes per level on sizes that aren't power of 2.
+  auto q = segbitset::segbitset<37>().profile();
+  std::size_t n37 = 0;
+  for (std::size_t d = 0; d < q.depth; d++) n37 += q.levels[d].nodes;
+  REQUIRE(n37 == 2 * 37 - 1);
+  REQUIRE(segbitset::segbitset<1>().profile().levels[0].nodes == 1);
+}
+
+TEST_CASE("adaptive", "[flat kernels and walks agree]") {
+  const std::size_t N = 1 << 16;
+  auto saved = segbitset::thresholds;
+  std::uniform_int_distribution<std::size_t> distribution(0, N - 1);
+  for (auto density : {0.0001, 0.01, 0.5}) {
+    std::bitset<N> a, b;
+    for (std::size_t i = 0; i < N * density; i++) a.set(distribution(rng)), b.set(distribution(rng));
+    for (auto t : {-1.0, 1.0}) {  // always flat, always walk
+      segbitset::thresholds = {t, t, t};
+      auto s = std::make_unique<segbitset::segbitset<N>>(a), o = std::make_unique<segbitset::segbitset<N>>(b);
+      REQUIRE(*s == *s);
+      REQUIRE((*s == *o) == (a == b));
+      *s |= *o;
+      REQUIRE(s->to_bitset() == (a | b));
+      REQUIRE(s->count() == (a | b).count());
+      s->reset();
+      REQUIRE(s->none());
+      REQUIRE(s->count() == 0);
+      s->set(7);
+      REQUIRE(s->first() == 7);
+      // set() fills the storage out of the tree too, which mustn't make equal sets differ.
+      auto all = std::make_unique<segbitset::segbitset<N>>();
+      auto each = std::make_unique<segbitset::segbitset<N>>();
+      all->set();
+      for (std::size_t pos = 0; pos < N; pos++) each->set(pos);
+      REQUIRE(*all == *each);
+    }
+  }
+  segbitset::thresholds = saved;
+}
+
+// brute force summary of bits [first, last) of a bitset.
+template <typename Summary, std::size_t N>
+typename Summary::value_type brute_summary(const std::bitset<N>& a, std::size_t first, std::size_t last) {
+  auto acc = Summary::identity();
+  for (auto i = first; i < last; i++) acc = Summary::combine(acc, Summary::leaf(a[i]));
+  return acc;
+}
+
+TEMPLATE_TEST_CASE("summary", "[pluggable summaries - compare to brute force]", segbitset::count_summary,
+                   segbitset::and_summary, segbitset::zero_run_summary) {
+  const std::size_t N = 317;
+  using S = segbitset::segbitset<N, segbitset::word_bitset, segbitset::no_stats, TestType>;
+  std::uniform_int_distribution<std::size_t> distribution(0, N - 1);
+  std::bitset<N> a, b;
+  random_fill_bitset(b);
+  S s, o(b);
+  auto check = [&] {
+    REQUIRE(s.to_bitset() == a);
+    REQUIRE(s.summary() == brute_summary<TestType>(a, 0, N));
+    for (int i = 0; i < 20; i++) {
+      auto first = distribution(rng), last = distribution(rng) + 1;
+      if (first > last) std::swap(first, last);
+      REQUIRE(s.summary(first, last) == brute_summary<TestType>(a, first, last));
+    }
+  };
+  check();
+  for (int i = 0; i < 600; i++) {
+    auto pos = distribution(rng);
+    switch (i % 4) {
+      case 0:
+        s.set(pos), a.set(pos);
+        break;
+      case 1:
+        s.reset(pos), a.reset(pos);
+        break;
+      case 2:
+        s.flip(pos), a.flip(pos);
+        break;
+      case 3:
+        s[pos] = !s[pos], a.flip(pos);
+        break;
+    }
+    if (i % 50 == 0) check();
+  }
+  check();
+  s &= o, a &= b;
+  check();
+  s ^= o, a ^= b;
+  check();
+  s |= o, a |= b;
+  check();
+  REQUIRE(s.intersects(o) == (a & b).any());
+  REQUIRE(s.count_and(o) == (a & b).count());
+  s.andnot(o), a &= ~b;
+  check();
+  REQUIRE(!s.intersects(o));
+  std::bitset<N> c;
+  random_fill_bitset(c);
+  S p(c);
+  s.or_andnot(o, p), a |= b & ~c;
+  check();
+  s = ~s, a = ~a;
+  check();
+  S t(s);
+  REQUIRE(t.summary() == s.summary());
+  s.reset(), a.reset();
+  check();
+  s.set(), a.set();
+  check();
+  t = s;
+  REQUIRE(t.summary() == s.summary());
+  REQUIRE(s.summary(5, 5) == TestType::identity());
+  REQUIRE_THROWS_AS(s.summary(0, N + 1), std::out_of_range);
+  REQUIRE_THROWS_AS(s.summary(3, 2), std::out_of_range);
+}
+
+TEST_CASE("summary", "[zero runs, constexpr and zero overhead default]") {
+  using S =
+      segbitset::segbitset<100, segbitset::word_bitset, segbitset::no_stats, segbitset::zero_run_summary>;
+  static constexpr auto s = [] {
+    S s;
+    for (std::size_t pos : {10, 11, 40, 90}) s.set(pos);
+    return s;
+  }();
+  static_assert(s.summary().longest == 49);  // [41, 90)
+  static_assert(s.summary().prefix == 10);
+  static_assert(s.summary().suffix == 9);
+  static_assert(s.summary(12, 40).longest == 28);
+  static_assert(segbitset::segbitset<100>().summary(0, 100) == false);
+  static_assert(sizeof(segbitset::segbitset<1000>) == sizeof(segbitset::word_bitset<1 + (1000 << 2)>));
+}
+
+TEST_CASE("intersects", "[compare to bitset]") {
+  const std::size_t N = 1000;
+  std::uniform_int_distribution<std::size_t> distribution(0, N - 1);
+  for (int i = 0; i < 200; i++) {
+    std::bitset<N> a, b;
+    for (int j = 0; j < i % 20; j++) a.set(distribution(rng)), b.set(distribution(rng));
+    segbitset::segbitset<N> s(a), o(b);
+    REQUIRE(s.intersects(o) == (a & b).any());
+    REQUIRE(o.intersects(s) == (a & b).any());
+    REQUIRE(s.intersects(s) == a.any());
+  }
+}
+
+TEST_CASE("andnot", "[compare to bitset]") {
+  const std::size_t N = 1000;
+  std::uniform_int_distribution<std::size_t> distribution(0, N - 1);
+  for (int i = 0; i < 100; i++) {
+    std::bitset<N> a, b;
+    for (int j = 0; j < i * 5; j++) a.set(distribution(rng));
+    for (int j = 0; j < (100 - i) * 5; j++) b.set(distribution(rng));
+    segbitset::segbitset<N> s(a), o(b);
+    s.andnot(o);
+    REQUIRE(s.to_bitset() == (a & ~b));
+    REQUIRE(s.count() == (a & ~b).count());
+  }
+}
+
+TEST_CASE("or_andnot", "[compare to bitset]") {
+  const std::size_t N = 1000;
+  std::uniform_int_distribution<std::size_t> distribution(0, N - 1);
+  for (int i = 0; i < 100; i++) {
+    std::bitset<N> a, b, c;
+    for (int j = 0; j < i * 5; j++) a.set(distribution(rng));
+    for (int j = 0; j < (100 - i) * 5; j++) b.set(distribution(rng));
+    for (int j = 0; j < 50; j++) c.set(distribution(rng));
+    segbitset::segbitset<N> s(c), o(a), p(b);
+    s.or_andnot(o, p);
+    REQUIRE(s.to_bitset() == (c | (a & ~b)));
+    REQUIRE(s.count() == (c | (a & ~b)).count());
+  }
+}
+
+TEST_CASE("count_and", "[compare to bitset]") {
+  const std::size_t N = 1000;
+  std::uniform_int_distribution<std::size_t> distribution(0, N - 1);
+  for (int i = 0; i < 100; i++) {
+    std::bitset<N> a, b;
+    for (int j = 0; j < i * 5; j++) a.set(distribution(rng));
+    for (int j = 0; j < (100 - i) * 5; j++) b.set(distribution(rng));
+    segbitset::segbitset<N> s(a), o(b);
+    REQUIRE(s.count_and(o) == (a & b).count());
+    REQUIRE(o.count_and(s) == (a & b).count());
+    REQUIRE(s.count_and(s) == a.count());
+  }
+}
@@ -0,0 +1,279 @@
+// Copyright (c) 2024 Chao Wang <hit9@icloud.com>.
+// License: BSD. https://github.com/hit9/segbitset
+// Operation trace recording for segbitset, to benchmark on real access patterns, see segbitset_replay.cc.
+//
+// Trace format (all integers are LEB128 varints):
+//   header: magic "SBT1", N
+//   record: op (1 byte), then by op:
+//     set, reset, flip, test, next: pos
+//     and_assign, or_assign, xor_assign, equal: the operand's true positions, as count and deltas
+//     others: nothing
+//
+// Usage:
+//   std::ofstream out("ops.trace", std::ios::binary);
+//   segbitset::trace::recorder r(s, out);  // s is a segbitset
+//   r.set(3);                              // records and forwards to s.set(3)
+
+#ifndef __HIT9_SEGBITSET_TRACE
+#define __HIT9_SEGBITSET_TRACE
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "segbitset.h"
+
+namespace segbitset {
+namespace trace {
+
+using size_t = std::size_t;
+
+enum class op : uint8_t {
+  set,         // set(pos)
+  reset,       // reset(pos), or set(pos, false)
+  flip,        // flip(pos)
+  test,        // test(pos)
+  next,        // next(pos)
+  first,       // first()
+  count,       // count()
+  any,         // any()
+  none,        // none()
+  all,         // all()
+  foreach1,    // foreach1(cb)
+  set_all,     // set()
+  reset_all,   // reset()
+  flip_all,    // flip()
+  and_assign,  // &= operand
+  or_assign,   // |= operand
+  xor_assign,  // ^= operand
+  equal,       // == operand
+  pop_first,   // pop_first()
+};
+
+// returns the name of an op.
+constexpr const char* name(op o) {
+  constexpr const char* names[] = {"set",       "reset",     "flip",       "test",      "next",
+                                   "first",     "count",     "any",        "none",      "all",
+                                   "foreach1",  "set_all",   "reset_all",  "flip_all",  "and_assign",
+                                   "or_assign", "xor_assign", "equal",     "pop_first"};
+  return names[static_cast<uint8_t>(o)];
+}
+
+// returns true if records of op o carry a position.
+constexpr bool has_pos(op o) { return o <= op::next; }
+
+// returns true if records of op o carry an operand.
+constexpr bool has_operand(op o) { return o >= op::and_assign && o <= op::equal; }
+
+struct record {
+  op o;
+  size_t pos = 0;                // for ops having a position
+  std::vector<size_t> operand;  // true positions of the operand, for ops having an operand
+};
+
+// writer encodes records into a binary stream.
+class writer {
+ public:
+  // writes the header of a trace on a segbitset of n bits.
+  writer(std::ostream& out, size_t n) : out(out) {
+    out.write("SBT1", 4);
+    varint(n);
+  }
+  void write(op o) { out.put(static_cast<char>(o)); }
+  void write(op o, size_t pos) {
+    write(o);
+    varint(pos);
+  }
+  template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+  void write(op o, const segbitset<N, Storage, Stats, Summary>& operand) {
+    write(o);
+    varint(operand.count());
+    size_t last = 0;
+    operand.foreach1([&](size_t pos) {
+      varint(pos - last);
+      last = pos;
+    });
+  }
+
+ private:
+  std::ostream& out;
+
+  void varint(uint64_t v) {
+    while (v >= 0x80) {
+      out.put(static_cast<char>(v | 0x80));
+      v >>= 7;
+    }
+    out.put(static_cast<char>(v));
+  }
+};
+
+// reader decodes records from a binary stream.
+// throws std::runtime_error on malformed traces.
+class reader {
+ public:
+  explicit reader(std::istream& in) : in(in) {
+    char magic[4];
+    if (!in.read(magic, 4) || std::string_view(magic, 4) != "SBT1")
+      throw std::runtime_error("segbitset::trace: bad magic");
+    n = varint();
+  }
+  // returns the number of bits of the traced segbitset.
+  size_t size() const { return n; }
+  // reads next record into r, returns false at the end of the trace.
+  bool read(record& r) {
+    auto c = in.get();
+    if (c == std::istream::traits_type::eof()) return false;
+    if (c > static_cast<int>(op::pop_first)) throw std::runtime_error("segbitset::trace: bad op");
+    r.o = static_cast<op>(c);
+    r.operand.clear();
+    r.pos = has_pos(r.o) ? varint() : 0;
+    if (has_operand(r.o)) {
+      size_t cnt = varint(), pos = 0;
+      if (cnt > n) throw std::runtime_error("segbitset::trace: bad operand");
+      r.operand.reserve(cnt);
+      for (size_t i = 0; i < cnt; i++) r.operand.push_back(pos += varint());
+    }
+    return true;
+  }
+
+ private:
+  std::istream& in;
+  size_t n = 0;
+
+  uint64_t varint() {
+    uint64_t v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      auto c = in.get();
+      if (c == std::istream::traits_type::eof()) throw std::runtime_error("segbitset::trace: truncated");
+      v |= uint64_t(c & 0x7f) << shift;
+      if (!(c & 0x80)) return v;
+    }
+    throw std::runtime_error("segbitset::trace: bad varint");
+  }
+};
+
+// recorder wraps a segbitset, records each operation to a trace and forwards it to the segbitset.
+template <size_t N, template <size_t> class Storage, typename Stats, typename Summary>
+class recorder {
+  using __segbitset = segbitset<N, Storage, Stats, Summary>;
+
+ public:
+  recorder(__segbitset& s, std::ostream& out) : s(s), w(out, N) {}
+
+  // returns the underlying segbitset, operations on which are not recorded.
+  __segbitset& get() noexcept { return s; }
+
+  size_t size() const noexcept { return N; }
+  // point operations check pos before recording, so that a call which throws leaves no record.
+  bool test(size_t pos) {
+    __check(pos);
+    w.write(op::test, pos);
+    return s.test(pos);
+  }
+  size_t count() {
+    w.write(op::count);
+    return s.count();
+  }
+  bool all() {
+    w.write(op::all);
+    return s.all();
+  }
+  bool any() {
+    w.write(op::any);
+    return s.any();
+  }
+  bool none() {
+    w.write(op::none);
+    return s.none();
+  }
+  size_t first() {
+    w.write(op::first);
+    return s.first();
+  }
+  size_t next(size_t pos) {
+    // nothing is after pos >= N - 1, recorded as next(N - 1) to keep the trace in range.
+    pos = std::min(pos, N - 1);
+    w.write(op::next, pos);
+    return s.next(pos);
+  }
+  size_t pop_first() {
+    w.write(op::pop_first);
+    return s.pop_first();
+  }
+  template <typename Callback>
+  void foreach1(Callback&& cb) {
+    w.write(op::foreach1);
+    s.foreach1(std::forward<Callback>(cb));
+  }
+  recorder& set() {
+    w.write(op::set_all);
+    s.set();
+    return *this;
+  }
+  recorder& set(size_t pos, bool value = true) {
+    __check(pos);
+    w.write(value ? op::set : op::reset, pos);
+    s.set(pos, value);
+    return *this;
+  }
+  recorder& reset() {
+    w.write(op::reset_all);
+    s.reset();
+    return *this;
+  }
+  recorder& reset(size_t pos) {
+    __check(pos);
+    w.write(op::reset, pos);
+    s.reset(pos);
+    return *this;
+  }
+  recorder& flip() {
+    w.write(op::flip_all);
+    s.flip();
+    return *this;
+  }
+  recorder& flip(size_t pos) {
+    __check(pos);
+    w.write(op::flip, pos);
+    s.flip(pos);
+    return *this;
+  }
+  recorder& operator&=(const __segbitset& o) {
+    w.write(op::and_assign, o);
+    s &= o;
+    return *this;
+  }
+  recorder& operator|=(const __segbitset& o) {
+    w.write(op::or_assign, o);
+    s |= o;
+    return *this;
+  }
+  recorder& operator^=(const __segbitset& o) {
+    w.write(op::xor_assign, o);
+    s ^= o;
+    return *this;
+  }
+  bool operator==(const __segbitset& o) {
+    w.write(op::equal, o);
+    return s == o;
+  }
+
+ private:
+  __segbitset& s;
+  writer w;
+
+  static void __check(size_t pos) {
+    if (pos >= N) throw std::out_of_range("segbitset::trace::recorder pos >= N");
+  }
+};
+
+}  // namespace trace
+}  // namespace segbitset
+
+#endif
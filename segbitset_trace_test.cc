@@ -0,0 +1,171 @@
+#include "segbitset_trace.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+static std::mt19937 rng(std::random_device{}());
+
+// applies a record on s, returns the result of query operations, 0 for others.
+template <std::size_t N>
+std::size_t apply(segbitset::segbitset<N>& s, const segbitset::trace::record& r) {
+  using segbitset::trace::op;
+  segbitset::segbitset<N> operand;
+  for (auto pos : r.operand) operand.set(pos);
+  std::size_t cnt = 0;
+  switch (r.o) {
+    case op::set:
+      return s.set(r.pos), 0;
+    case op::reset:
+      return s.reset(r.pos), 0;
+    case op::flip:
+      return s.flip(r.pos), 0;
+    case op::test:
+      return s.test(r.pos);
+    case op::next:
+      return s.next(r.pos);
+    case op::first:
+      return s.first();
+    case op::count:
+      return s.count();
+    case op::any:
+      return s.any();
+    case op::none:
+      return s.none();
+    case op::all:
+      return s.all();
+    case op::foreach1:
+      s.foreach1([&](std::size_t) { ++cnt; });
+      return cnt;
+    case op::set_all:
+      return s.set(), 0;
+    case op::reset_all:
+      return s.reset(), 0;
+    case op::flip_all:
+      return s.flip(), 0;
+    case op::and_assign:
+      return s &= operand, 0;
+    case op::or_assign:
+      return s |= operand, 0;
+    case op::xor_assign:
+      return s ^= operand, 0;
+    case op::equal:
+      return s == operand;
+    case op::pop_first:
+      return s.pop_first();
+  }
+  return 0;
+}
+
+TEST_CASE("trace", "[record and replay]") {
+  const std::size_t N = 1000;
+  std::uniform_int_distribution<std::size_t> distribution(0, N - 1);
+  segbitset::segbitset<N> s, o;
+  for (std::size_t i = 0; i < 50; i++) o.set(distribution(rng));
+
+  std::stringstream buf;
+  std::vector<std::size_t> results;
+  segbitset::trace::recorder r(s, buf);
+  for (std::size_t i = 0; i < 200; i++) {
+    auto pos = distribution(rng);
+    r.set(pos);
+    r.set(distribution(rng), false);
+    r.reset(distribution(rng));
+    r.flip(distribution(rng));
+    results.push_back(r.test(pos));
+    results.push_back(r.next(distribution(rng)));
+  }
+  results.push_back(r.first());
+  results.push_back(r.pop_first());
+  results.push_back(r.count());
+  results.push_back(r.any());
+  results.push_back(r.none());
+  results.push_back(r.all());
+  std::size_t cnt = 0;
+  r.foreach1([&](std::size_t) { ++cnt; });
+  results.push_back(cnt);
+  r &= o;
+  r |= o;
+  r ^= o;
+  results.push_back(r == o);
+  r.flip();
+  results.push_back(r.count());
+  r.set();
+  r.reset();
+  REQUIRE(&r.get() == &s);
+  REQUIRE(r.size() == N);
+
+  segbitset::trace::reader reader(buf);
+  REQUIRE(reader.size() == N);
+  segbitset::segbitset<N> replayed;
+  std::vector<std::size_t> replayed_results;
+  for (segbitset::trace::record rec; reader.read(rec);) {
+    auto ans = apply(replayed, rec);
+    switch (rec.o) {
+      case segbitset::trace::op::test:
+      case segbitset::trace::op::next:
+      case segbitset::trace::op::first:
+      case segbitset::trace::op::count:
+      case segbitset::trace::op::any:
+      case segbitset::trace::op::none:
+      case segbitset::trace::op::all:
+      case segbitset::trace::op::foreach1:
+      case segbitset::trace::op::equal:
+      case segbitset::trace::op::pop_first:
+        replayed_results.push_back(ans);
+        break;
+      default:
+        break;
+    }
+  }
+  REQUIRE(replayed_results == results);
+  REQUIRE(replayed == s);
+}
+
+TEST_CASE("trace", "[malformed traces]") {
+  std::stringstream bad_magic("SBTX\x08");
+  REQUIRE_THROWS_AS(segbitset::trace::reader(bad_magic), std::runtime_error);
+
+  std::stringstream truncated;
+  {
+    segbitset::trace::writer w(truncated, 1000);
+    w.write(segbitset::trace::op::set, 999);
+  }
+  auto data = truncated.str();
+  std::stringstream in(data.substr(0, data.size() - 1));
+  segbitset::trace::reader reader(in);
+  segbitset::trace::record rec;
+  REQUIRE_THROWS_AS(reader.read(rec), std::runtime_error);
+
+  // an operand of more positions than the traced size.
+  std::stringstream oversized;
+  {
+    segbitset::trace::writer w(oversized, 8);
+    w.write(segbitset::trace::op::equal, segbitset::segbitset<1000>().set());
+  }
+  segbitset::trace::reader oversized_reader(oversized);
+  REQUIRE_THROWS_AS(oversized_reader.read(rec), std::runtime_error);
+}
+
+TEST_CASE("trace", "[out of range calls leave no record]") {
+  const std::size_t N = 1000;
+  segbitset::segbitset<N> s;
+  std::stringstream buf;
+  segbitset::trace::recorder r(s, buf);
+  REQUIRE_THROWS_AS(r.set(N), std::out_of_range);
+  REQUIRE_THROWS_AS(r.reset(N), std::out_of_range);
+  REQUIRE_THROWS_AS(r.flip(N), std::out_of_range);
+  REQUIRE_THROWS_AS(r.test(N), std::out_of_range);
+  r.set(N - 1);
+  REQUIRE(r.next(N + 5) == N);
+
+  segbitset::trace::reader reader(buf);
+  std::vector<segbitset::trace::record> records;
+  for (segbitset::trace::record rec; reader.read(rec);) records.push_back(rec);
+  REQUIRE(records.size() == 2);
+  REQUIRE(records[0].o == segbitset::trace::op::set);
+  REQUIRE(records[1].o == segbitset::trace::op::next);
+  REQUIRE(records[1].pos == N - 1);
+}
@@ -0,0 +1,91 @@
+// Benchmarks on every tree walk, to compare the walk engines.
+// This file is built twice: segbitset_walk_benchmark walks iteratively on an explicit stack,
+// segbitset_walk_benchmark_recursive walks recursively (with SEGBITSET_RECURSIVE_WALK defined).
+
+#include <bitset>
+#include <catch2/benchmark/catch_benchmark_all.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "segbitset.h"
+
+#ifdef SEGBITSET_RECURSIVE_WALK
+static const std::string WALK = "recursive";
+#else
+static const std::string WALK = "iterative";
+#endif
+
+static const std::size_t N_100K_BITS = 100000;
+static const std::size_t N_1G_BITS = 1024 * 1024 * 1024;
+static const std::size_t MAX_COPIES_BYTES = 256 << 20;
+static std::mt19937 rng(std::random_device{}());
+
+template <std::size_t N>
+void benchmark_walks(const std::string& label) {
+  using S = segbitset::segbitset<N>;
+  // about 1/50 bits (about 2%) are set on both operands.
+  std::uniform_int_distribution<std::size_t> distribution(0, N - 1);
+  auto s1 = std::make_unique<S>(), s2 = std::make_unique<S>();
+  for (std::size_t i = 0; i < N / 50; i++) s1->set(distribution(rng));
+  for (std::size_t i = 0; i < N / 50; i++) s2->set(distribution(rng));
+  auto b = std::make_unique<std::bitset<N>>();
+  s1->to_bitset(*b);
+  auto s1_copy = std::make_unique<S>(*s1), scratch = std::make_unique<S>();
+
+  auto name = [&](const std::string& op) { return WALK + " - " + label + " - " + op; };
+
+  // runs op on a fresh copy of s1 each time, for operations modifying s1. The copies are made ahead of the
+  // measurement if they fit in MAX_COPIES_BYTES, otherwise each run copies s1 to a scratch segbitset first,
+  // whose cost is measured by "copy".
+  auto measure_on_copies = [&](Catch::Benchmark::Chronometer meter, auto op) {
+    if (meter.runs() * sizeof(S) <= MAX_COPIES_BYTES) {
+      std::vector<std::unique_ptr<S>> copies(meter.runs());
+      for (auto& c : copies) c = std::make_unique<S>(*s1);
+      meter.measure([&](int i) { op(*copies[i]); });
+    } else {
+      meter.measure([&] {
+        *scratch = *s1;
+        op(*scratch);
+      });
+    }
+  };
+
+  std::size_t cnt = 0;  // avoid compiler optimization away
+
+  BENCHMARK(name("build")) { return std::make_unique<S>(*b)->any(); };
+  BENCHMARK(name("count")) { return s1->count(); };
+  BENCHMARK(name("all")) { return s1->all(); };
+  BENCHMARK(name("==")) { return *s1 == *s1_copy; };
+  BENCHMARK(name("first and next")) {
+    for (std::size_t pos = s1->first(); pos != N; pos = s1->next(pos)) ++cnt;
+  };
+  BENCHMARK(name("foreach1")) { s1->foreach1([&](std::size_t) { ++cnt; }); };
+  BENCHMARK(name("to_bitset")) { s1->to_bitset(*b); };
+  BENCHMARK(name("copy")) { *scratch = *s1; };
+  BENCHMARK_ADVANCED(name("flip"))(Catch::Benchmark::Chronometer meter) {
+    measure_on_copies(meter, [](S& s) { s.flip(); });
+  };
+  BENCHMARK_ADVANCED(name("reset"))(Catch::Benchmark::Chronometer meter) {
+    measure_on_copies(meter, [](S& s) { s.reset(); });
+  };
+  BENCHMARK_ADVANCED(name("&="))(Catch::Benchmark::Chronometer meter) {
+    measure_on_copies(meter, [&](S& s) { s &= *s2; });
+  };
+  BENCHMARK_ADVANCED(name("|="))(Catch::Benchmark::Chronometer meter) {
+    measure_on_copies(meter, [&](S& s) { s |= *s2; });
+  };
+  BENCHMARK_ADVANCED(name("^="))(Catch::Benchmark::Chronometer meter) {
+    measure_on_copies(meter, [&](S& s) { s ^= *s2; });
+  };
+}
+
+TEST_CASE("benchmark/walk/100K", "recursion vs iteration on every tree walk, 100K bits") {
+  benchmark_walks<N_100K_BITS>("100K");
+}
+
+TEST_CASE("benchmark/walk/1G", "recursion vs iteration on every tree walk, 1G bits") {
+  benchmark_walks<N_1G_BITS>("1G");
+}